@@ -0,0 +1,111 @@
+local test_env = require("spec.util.test_env")
+local lfs = require("lfs")
+local run = test_env.run
+local testing_paths = test_env.testing_paths
+local write_file = test_env.write_file
+
+describe("luarocks bundle #integration", function()
+
+   before_each(function()
+      test_env.setup_specs()
+   end)
+
+   it("with no arguments", function()
+      assert.is_false(run.luarocks_bool("bundle"))
+   end)
+
+   it("bundles the dependencies of a rockspec for an offline installation", function()
+      test_env.run_in_tmp(function(tmpdir)
+         write_file("test-2.0-1.rockspec", [[
+            package = "test"
+            version = "2.0-1"
+            source = {
+               url = "file://]] .. tmpdir:gsub("\\", "/") .. [[/test.lua"
+            }
+            dependencies = {
+               "a_rock >= 0.8"
+            }
+            build = {
+               type = "builtin",
+               modules = {
+                  test = "test.lua"
+               }
+            }
+         ]])
+         write_file("test.lua", "return {}")
+
+         assert.is_true(run.luarocks_bool("bundle test-2.0-1.rockspec --only-server=" .. testing_paths.fixtures_dir .. "/a_repo"))
+         assert.is.truthy(lfs.attributes("test-2.0-1.bundle.zip"))
+
+         assert.is_true(run.luarocks_bool("make --bundle=test-2.0-1.bundle.zip --tree=lua_modules"))
+         assert.is.truthy(lfs.attributes("./lua_modules/lib/luarocks/rocks-" .. test_env.lua_version .. "/a_rock"))
+      end, finally)
+   end)
+
+   it("installs the artifacts pinned in a lock file from the bundle with --frozen", function()
+      test_env.run_in_tmp(function(tmpdir)
+         write_file("test-2.0-1.rockspec", [[
+            package = "test"
+            version = "2.0-1"
+            source = {
+               url = "file://]] .. tmpdir:gsub("\\", "/") .. [[/test.lua"
+            }
+            dependencies = {
+               "a_rock >= 0.8"
+            }
+            build = {
+               type = "builtin",
+               modules = {
+                  test = "test.lua"
+               }
+            }
+         ]])
+         write_file("test.lua", "return {}")
+
+         assert.is_true(run.luarocks_bool("make --pin --server=" .. testing_paths.fixtures_dir .. "/a_repo --tree=lua_modules"))
+         assert.is_true(run.luarocks_bool("bundle luarocks.lock --only-server=" .. testing_paths.fixtures_dir .. "/a_repo"))
+         test_env.remove_dir("lua_modules")
+
+         -- the artifacts are not downloaded again
+         local fd = assert(io.open("luarocks.lock"))
+         local lockfile = fd:read("*a")
+         fd:close()
+         write_file("luarocks.lock", (lockfile:gsub('url = "[^"]*/', 'url = "http://localhost:1/')))
+
+         assert.is_true(run.luarocks_bool("make --frozen --bundle=luarocks.bundle.zip --tree=lua_modules"))
+         assert.is.truthy(lfs.attributes("./lua_modules/lib/luarocks/rocks-" .. test_env.lua_version .. "/a_rock"))
+      end, finally)
+   end)
+
+   it("fails when two rocks have the same file name", function()
+      test_env.run_in_tmp(function(tmpdir)
+         local a_repo = testing_paths.fixtures_dir:gsub("\\", "/") .. "/a_repo"
+         assert(lfs.mkdir("other"))
+         local fd = assert(io.open(a_repo .. "/a_rock-2.0-1.src.rock", "rb"))
+         write_file("other/a_rock-1.0-1.src.rock", fd:read("*a"))
+         fd:close()
+         write_file("luarocks.lock", [[
+            return {
+               dependencies = {
+                  a_rock = "1.0-1",
+                  b_rock = "1.0-1",
+               },
+               artifacts = {
+                  a_rock = { ["1.0-1"] = { url = "]] .. a_repo .. [[/a_rock-1.0-1.src.rock", sha256 = "00" } },
+                  b_rock = { ["1.0-1"] = { url = "]] .. tmpdir:gsub("\\", "/") .. [[/other/a_rock-1.0-1.src.rock", sha256 = "00" } },
+               },
+            }
+         ]])
+         local output = run.luarocks("bundle luarocks.lock")
+         assert.match("same file name", output, 1, true)
+         assert.is.falsy(lfs.attributes("luarocks.bundle.zip"))
+      end, finally)
+   end)
+
+   it("fails with a file which is not a bundle", function()
+      test_env.run_in_tmp(function()
+         write_file("not_a_bundle.zip", "")
+         assert.is_false(run.luarocks_bool("install --bundle=not_a_bundle.zip a_rock"))
+      end, finally)
+   end)
+end)
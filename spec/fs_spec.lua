@@ -73,4 +73,147 @@ describe("luarocks.fs #integration", function()
          assert.falsy(fs.download("invalidurl"))
       end)
    end)
+
+   describe("fs.download with cache #mock", function()
+      local cfg
+      local tmpdir
+      local cache_timeout
+
+      lazy_setup(function()
+         test_env.setup_specs(nil, "mock")
+         cfg = require("luarocks.core.cfg")
+         fs = require("luarocks.fs")
+         cfg.init()
+         fs.init()
+         test_env.conditional_server_init()
+      end)
+
+      lazy_teardown(function()
+         test_env.conditional_server_done()
+      end)
+
+      before_each(function()
+         tmpdir = get_tmp_path()
+         lfs.mkdir(tmpdir)
+         -- always ask the server
+         cache_timeout = cfg.cache_timeout
+         cfg.cache_timeout = 0
+      end)
+
+      after_each(function()
+         cfg.cache_timeout = cache_timeout
+         fs.delete(tmpdir)
+      end)
+
+      local function bytes_sent()
+         local file = tmpdir .. "/bytes"
+         assert.truthy(fs.download("http://localhost:8081/bytes", file))
+         local fd = assert(io.open(file, "r"))
+         local bytes = tonumber(fd:read("*a"))
+         fd:close()
+         return bytes
+      end
+
+      local function misses()
+         local file = tmpdir .. "/misses"
+         assert.truthy(fs.download("http://localhost:8081/misses", file))
+         local fd = assert(io.open(file, "r"))
+         local count = tonumber(fd:read("*a"))
+         fd:close()
+         return count
+      end
+
+      for _, downloader in ipairs({ "download", "use_downloader" }) do
+         it("revalidates cached files with their ETag using fs." .. downloader, function()
+            local url = "http://localhost:8081/a_rock-1.0-1.src.rock"
+            local file = tmpdir .. "/a_rock-1.0-1.src.rock"
+
+            local before = bytes_sent()
+            local name, _, _, from_cache = fs[downloader](url, file, true)
+            assert.same(file, name)
+            assert.falsy(from_cache)
+            local after = bytes_sent()
+            assert.is_true(after > before)
+
+            -- the Last-Modified date changed, but the ETag did not
+            name, _, _, from_cache = fs[downloader](url, file, true)
+            assert.same(file, name)
+            assert.truthy(from_cache)
+            assert.same(after, bytes_sent())
+            assert.same(lfs.attributes(testing_paths.fixtures_dir .. "/a_rock-1.0-1.src.rock", "size"), lfs.attributes(file, "size"))
+         end)
+
+         it("does not request a missing file again before cache_fail_timeout using fs." .. downloader, function()
+            local url = "http://localhost:8081/nonexistent"
+            local file = tmpdir .. "/nonexistent"
+
+            local before = misses()
+            assert.falsy(fs[downloader](url, file, true))
+            assert.same(before + 1, misses())
+            assert.falsy(fs[downloader](url, file, true))
+            assert.same(before + 1, misses())
+         end)
+      end
+   end)
+
+   describe("fs.download reusing connections #mock", function()
+      local tmpdir
+
+      lazy_setup(function()
+         test_env.setup_specs(nil, "mock")
+         local cfg = require("luarocks.core.cfg")
+         fs = require("luarocks.fs")
+         cfg.init()
+         fs.init()
+         test_env.keepalive_server_init()
+      end)
+
+      lazy_teardown(function()
+         test_env.keepalive_server_done()
+      end)
+
+      before_each(function()
+         tmpdir = get_tmp_path()
+         lfs.mkdir(tmpdir)
+      end)
+
+      after_each(function()
+         fs.delete(tmpdir)
+      end)
+
+      local function connections()
+         local file = tmpdir .. "/connections"
+         assert.truthy(fs.download("http://localhost:8082/connections", file))
+         local fd = assert(io.open(file, "r"))
+         local count = tonumber(fd:read("*a"))
+         fd:close()
+         return count
+      end
+
+      local function assert_downloaded(name)
+         local file = tmpdir .. "/" .. name
+         assert.truthy(fs.download("http://localhost:8082/" .. name, file))
+         assert.same(lfs.attributes(testing_paths.fixtures_dir .. "/" .. name, "size"), lfs.attributes(file, "size"))
+      end
+
+      if not pcall(require, "socket.http") then
+         pending("needs LuaSocket to download files")
+         return
+      end
+
+      it("downloads several files through one connection", function()
+         local before = connections()
+         assert_downloaded("a_rock-1.0-1.src.rock")
+         assert_downloaded("build_only_deps-0.1-1.src.rock")
+         assert_downloaded("a_rock.lua")
+         assert.same(before, connections())
+      end)
+
+      it("retries on a new connection when the server closed the idle one", function()
+         local before = connections()
+         assert.truthy(fs.download("http://localhost:8082/drop-idle", tmpdir .. "/drop-idle"))
+         assert_downloaded("a_rock-1.0-1.src.rock")
+         assert.same(before + 1, connections())
+      end)
+   end)
 end)
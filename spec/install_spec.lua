@@ -205,6 +205,58 @@ describe("luarocks install #integration", function()
       end, finally)
    end)
 
+   it("compacts a journal started on an earlier manifest #journal", function()
+      test_env.run_in_tmp(function(tmpdir)
+         local server = " --tree=lua_modules --server=" .. testing_paths.fixtures_dir .. "/a_repo"
+         local rocks_dir = "lua_modules/lib/luarocks/rocks-" .. test_env.lua_version
+         local journal = rocks_dir .. "/manifest.journal"
+
+         assert.is_true(run.luarocks_bool("install a_rock 1.0-1" .. server))
+         local fd = assert(io.open(rocks_dir .. "/manifest", "rb"))
+         local manifest = fd:read("*a")
+         fd:close()
+         assert.is_true(run.luarocks_bool("install a_build_dep 1.0-1" .. server))
+         assert.is.truthy(lfs.attributes(journal))
+
+         -- a tool that does not know about the journal removes a_build_dep
+         -- and rewrites the manifest
+         write_file(rocks_dir .. "/manifest", (manifest:gsub("%-%- loader_index: %w+%s*$", "")))
+         test_env.remove_dir(rocks_dir .. "/a_build_dep")
+         assert.is_false(run.luarocks_bool("show a_build_dep --tree=lua_modules"))
+
+         assert.is_true(run.luarocks_bool("install non_lua_file 1.0-1" .. server))
+         assert.is.falsy(lfs.attributes(journal))
+         assert.is_true(run.luarocks_bool("show non_lua_file --tree=lua_modules"))
+         assert.is_true(run.luarocks_bool("show a_rock --tree=lua_modules"))
+         assert.is_false(run.luarocks_bool("show a_build_dep --tree=lua_modules"))
+      end, finally)
+   end)
+
+   it("keeps journaled rocks when a tool that does not know about the journal rewrites the manifest #journal", function()
+      test_env.run_in_tmp(function(tmpdir)
+         local server = " --tree=lua_modules --server=" .. testing_paths.fixtures_dir .. "/a_repo"
+         local rocks_dir = "lua_modules/lib/luarocks/rocks-" .. test_env.lua_version
+         local journal = rocks_dir .. "/manifest.journal"
+
+         assert.is_true(run.luarocks_bool("install a_rock 1.0-1" .. server))
+         local fd = assert(io.open(rocks_dir .. "/manifest", "rb"))
+         local manifest = fd:read("*a")
+         fd:close()
+         assert.is_true(run.luarocks_bool("install a_build_dep 1.0-1" .. server))
+         assert.is.truthy(lfs.attributes(journal))
+
+         -- the manifest is rewritten without a_build_dep, which was only
+         -- recorded in the journal, and without a stamp
+         write_file(rocks_dir .. "/manifest", (manifest:gsub("%-%- loader_index: %w+%s*$", "")))
+         assert.is_true(run.luarocks_bool("show a_build_dep --tree=lua_modules"))
+
+         assert.is_true(run.luarocks_bool("install non_lua_file 1.0-1" .. server))
+         assert.is.falsy(lfs.attributes(journal))
+         assert.is_true(run.luarocks_bool("show a_build_dep --tree=lua_modules"))
+         assert.is_true(run.luarocks_bool("show non_lua_file --tree=lua_modules"))
+      end, finally)
+   end)
+
    describe("#unix install runs build from #git", function()
       local git
 
@@ -2,6 +2,8 @@ local test_env = require("spec.util.test_env")
 local run = test_env.run
 local testing_paths = test_env.testing_paths
 local write_file = test_env.write_file
+local Q = test_env.Q
+local lfs = require("lfs")
 
 describe("luarocks.loader", function()
 
@@ -69,5 +71,156 @@ describe("luarocks.loader", function()
             assert.matches("ROCK B 0.1", output, 1, true)
          end, finally)
       end)
+
+      it("ignores a loader index that does not match the manifest", function()
+         test_env.run_in_tmp(function(tmpdir)
+            write_file("rock_c.lua", "print('ROCK C'); return {}")
+            write_file("rock_c-1.0-1.rockspec", [[
+               package = "rock_c"
+               version = "1.0-1"
+               source = {
+                  url = "file://]] .. tmpdir:gsub("\\", "/") .. [[/rock_c.lua"
+               }
+               build = {
+                  type = "builtin",
+                  modules = {
+                     rock_c = "rock_c.lua"
+                  }
+               }
+            ]])
+
+            assert.is_true(run.luarocks_bool("make --tree=" .. testing_paths.testing_tree .. " ./rock_c-1.0-1.rockspec"))
+
+            local index_file = testing_paths.testing_rocks .. "/loader_index"
+            local fd = assert(io.open(index_file))
+            local index = fd:read("*a")
+            fd:close()
+            assert.matches("rock_c.lua", index, 1, true)
+
+            local output = run.lua([[-e "require 'luarocks.loader'; require('rock_c')"]])
+            assert.matches("ROCK C", output, 1, true)
+
+            -- A stale index must not be trusted
+            write_file(index_file, (index:gsub("rock_c%.lua", "missing.lua")))
+            local manifest_file = testing_paths.testing_rocks .. "/manifest"
+            fd = assert(io.open(manifest_file))
+            local manifest = fd:read("*a")
+            fd:close()
+            write_file(manifest_file, (manifest:gsub("%-%- loader_index: %w+\n", "")))
+
+            output = run.lua([[-e "require 'luarocks.loader'; require('rock_c')"]])
+            assert.matches("ROCK C", output, 1, true)
+         end, finally)
+      end)
+
+      it("memoizes module resolution until the rocks trees change", function()
+         test_env.run_in_tmp(function(tmpdir)
+            write_file("rock_f.lua", "print('ROCK F'); return {}")
+            write_file("rock_f-1.0-1.rockspec", [[
+               package = "rock_f"
+               version = "1.0-1"
+               source = {
+                  url = "file://]] .. tmpdir:gsub("\\", "/") .. [[/rock_f.lua"
+               }
+               build = {
+                  type = "builtin",
+                  modules = {
+                     rock_f = "rock_f.lua"
+                  }
+               }
+            ]])
+
+            local install = Q(testing_paths.lua) .. " " .. Q(testing_paths.src_dir .. "/bin/luarocks") .. " make --tree=" .. Q(testing_paths.testing_tree) .. " rock_f-1.0-1.rockspec"
+            local manifest = testing_paths.testing_rocks .. "/manifest"
+            write_file("memo.lua", [=[
+               local cfg = require("luarocks.core.cfg")
+               require("luarocks.loader")
+               -- only the loader can find the module
+               cfg.loader_direct_paths = true
+               cfg.loader_check_interval = 3600
+
+               local function try(name)
+                  package.loaded[name] = nil
+                  local lua_path, lua_cpath = package.path, package.cpath
+                  package.path, package.cpath = "", ""
+                  local ok = pcall(require, name)
+                  package.path, package.cpath = lua_path, lua_cpath
+                  return ok
+               end
+
+               print("BEFORE INSTALL " .. tostring(try("rock_f")))
+               os.execute([==[]=] .. install .. [=[]==])
+               print("MISSING FROM MEMO " .. tostring(try("rock_f")))
+               cfg.loader_check_interval = 0
+               print("AFTER INSTALL " .. tostring(try("rock_f")))
+
+               cfg.loader_check_interval = 3600
+               try("rock_f")
+               local manifest = [==[]=] .. manifest .. [=[]==]
+               assert(os.rename(manifest, manifest .. ".bak"))
+               print("FOUND IN MEMO " .. tostring(try("rock_f")))
+               cfg.loader_check_interval = 0
+               print("WITHOUT MANIFEST " .. tostring(try("rock_f")))
+               assert(os.rename(manifest .. ".bak", manifest))
+            ]=])
+
+            local output = run.lua("memo.lua")
+            assert.matches("BEFORE INSTALL false", output, 1, true)
+            -- the module not found is remembered until the trees are checked
+            assert.matches("MISSING FROM MEMO false", output, 1, true)
+            assert.matches("AFTER INSTALL true", output, 1, true)
+            assert.matches("FOUND IN MEMO true", output, 1, true)
+            assert.matches("WITHOUT MANIFEST false", output, 1, true)
+         end, finally)
+      end)
+
+      it("prefers precompiled modules when lua_bytecode_cache is enabled", function()
+         test_env.run_in_tmp(function(tmpdir)
+            write_file("rock_d.lua", "print('ROCK D'); return {}")
+            write_file("rock_d-1.0-1.rockspec", [[
+               package = "rock_d"
+               version = "1.0-1"
+               source = {
+                  url = "file://]] .. tmpdir:gsub("\\", "/") .. [[/rock_d.lua"
+               }
+               build = {
+                  type = "builtin",
+                  modules = {
+                     rock_d = "rock_d.lua"
+                  }
+               }
+            ]])
+
+            local fd = assert(io.open(test_env.env_variables.LUAROCKS_CONFIG, "a"))
+            fd:write("\nlua_bytecode_cache = true\n")
+            fd:close()
+
+            assert.is_true(run.luarocks_bool("make --tree=" .. testing_paths.testing_tree .. " ./rock_d-1.0-1.rockspec"))
+            local bytecode_dir = testing_paths.testing_rocks .. "-bytecode/rock_d/1.0-1"
+            assert.is.truthy(lfs.attributes(bytecode_dir))
+            -- only the deployed source can be found from here on
+            os.remove("rock_d.lua")
+
+            -- The bytecode file is preferred while the source is unchanged
+            local bytecode_file
+            for file in lfs.dir(bytecode_dir) do
+               if file:match("%.luac$") then
+                  bytecode_file = bytecode_dir .. "/" .. file
+               end
+            end
+            write_file(bytecode_file, "print('BYTECODE'); return {}")
+            local output = run.lua([[-e "require 'luarocks.loader'; require('rock_d')"]])
+            assert.matches("BYTECODE", output, 1, true)
+
+            -- An edited source takes effect
+            write_file(testing_paths.testing_tree .. "/share/lua/" .. test_env.lua_version .. "/rock_d.lua", "error('SOURCE')")
+            output = run.lua([[-e "require 'luarocks.loader'; print(pcall(require, 'rock_d'))"]])
+            assert.matches("SOURCE", output, 1, true)
+            assert.no.match("BYTECODE", output, 1, true)
+
+            assert.is_true(run.luarocks_bool("remove --tree=" .. testing_paths.testing_tree .. " rock_d"))
+            assert.is.falsy(lfs.attributes(bytecode_dir))
+         end, finally)
+      end)
    end)
 end)
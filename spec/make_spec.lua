@@ -178,6 +178,150 @@ describe("luarocks make #integration", function()
       end, finally)
    end)
 
+   it("installs the artifacts pinned in luarocks.lock with --frozen #pinning", function()
+      test_env.run_in_tmp(function(tmpdir)
+         write_file("test-2.0-1.rockspec", [[
+            package = "test"
+            version = "2.0-1"
+            source = {
+               url = "file://]] .. tmpdir:gsub("\\", "/") .. [[/test.lua"
+            }
+            dependencies = {
+               "a_rock >= 0.8"
+            }
+            build = {
+               type = "builtin",
+               modules = {
+                  test = "test.lua"
+               }
+            }
+         ]])
+         write_file("test.lua", "return {}")
+         local rocks_dir = "./lua_modules/lib/luarocks/rocks-" .. test_env.lua_version
+
+         assert.is_true(run.luarocks_bool("make --pin --server=" .. testing_paths.fixtures_dir .. "/a_repo --tree=lua_modules"))
+         local lockdata = loadfile("luarocks.lock")()
+         local version = lockdata.dependencies.a_rock
+         local artifact = lockdata.artifacts.a_rock[version]
+         assert.is.truthy(artifact.url:match("a_rock%-.*%.rock$"))
+         assert.same(64, #artifact.sha256)
+
+         -- no rocks server is searched
+         test_env.remove_dir("lua_modules")
+         assert.is_true(run.luarocks_bool("make --frozen --only-server=" .. tmpdir .. "/empty --tree=lua_modules"))
+         assert.is.truthy(lfs.attributes(rocks_dir .. "/a_rock/" .. version))
+
+         test_env.remove_dir("lua_modules")
+         local fd = assert(io.open("luarocks.lock"))
+         local lockfile = fd:read("*a")
+         fd:close()
+         write_file("luarocks.lock", (lockfile:gsub(artifact.sha256, ("0"):rep(64))))
+         local output = run.luarocks("make --frozen --tree=lua_modules")
+         assert.is.truthy(output:match("Digest mismatch"))
+         assert.is.falsy(lfs.attributes(rocks_dir .. "/a_rock"))
+      end, finally)
+   end)
+
+   it("pins a rock which can be installed on any platform #pinning", function()
+      test_env.run_in_tmp(function(tmpdir)
+         write_file("test-2.0-1.rockspec", [[
+            package = "test"
+            version = "2.0-1"
+            source = {
+               url = "file://]] .. tmpdir:gsub("\\", "/") .. [[/test.lua"
+            }
+            dependencies = {
+               "a_rock 1.0-1"
+            }
+            build = {
+               type = "builtin",
+               modules = {
+                  test = "test.lua"
+               }
+            }
+         ]])
+         write_file("test.lua", "return {}")
+
+         -- a server with both a binary rock for this platform and a source rock
+         assert.is_true(run.luarocks_bool("install a_rock 1.0-1 --server=" .. testing_paths.fixtures_dir .. "/a_repo --tree=lua_modules"))
+         lfs.mkdir("repo")
+         lfs.chdir("repo")
+         assert.is_true(run.luarocks_bool("pack a_rock 1.0-1 --tree=" .. tmpdir .. "/lua_modules"))
+         assert(os.rename("a_rock-1.0-1.all.rock", "a_rock-1.0-1." .. test_env.platform .. ".rock"))
+         test_env.copy(testing_paths.fixtures_dir .. "/a_repo/a_rock-1.0-1.src.rock", "a_rock-1.0-1.src.rock")
+         lfs.chdir(tmpdir)
+         assert.is_true(run.luarocks_admin_bool("make_manifest repo"))
+         test_env.remove_dir("lua_modules")
+
+         assert.is_true(run.luarocks_bool("make --pin --only-server=" .. tmpdir .. "/repo --tree=lua_modules"))
+         local lockdata = loadfile("luarocks.lock")()
+         assert.is.truthy(lockdata.artifacts.a_rock["1.0-1"].url:match("a_rock%-1%.0%-1%.src%.rock$"))
+      end, finally)
+   end)
+
+   it("installs pinned build dependencies first with --frozen #pinning", function()
+      test_env.run_in_tmp(function(tmpdir)
+         local a_repo = testing_paths.fixtures_dir:gsub("\\", "/") .. "/a_repo"
+         write_file("test-1.0-1.rockspec", [[
+            package = "test"
+            version = "1.0-1"
+            source = {
+               url = "file://]] .. tmpdir:gsub("\\", "/") .. [[/test.lua"
+            }
+            dependencies = {
+               "has_build_dep"
+            }
+            build = {
+               type = "builtin",
+               modules = {
+                  test = "test.lua"
+               }
+            }
+         ]])
+         write_file("test.lua", "return {}")
+         local cfg = require("luarocks.core.cfg")
+         local fs = require("luarocks.fs")
+         cfg.init()
+         fs.init()
+         local function artifact(file)
+            local sha256 = assert(fs.get_sha256(a_repo .. "/" .. file))
+            return [[{ url = "]] .. a_repo .. "/" .. file .. [[", sha256 = "]] .. sha256 .. [[" }]]
+         end
+         local lockfile = [[
+            return {
+               artifacts = {
+                  has_build_dep = { ["1.0-1"] = ]] .. artifact("has_build_dep-1.0-1.src.rock") .. [[ },
+                  a_rock = { ["1.0-1"] = ]] .. artifact("a_rock-1.0-1.src.rock") .. [[ },
+                  %s
+               },
+               dependencies = {
+                  has_build_dep = "1.0-1",
+                  a_rock = "1.0-1",
+                  %s
+               },
+            }
+         ]]
+         local rocks_dir = "./lua_modules/lib/luarocks/rocks-" .. test_env.lua_version
+
+         write_file("luarocks.lock", lockfile:format("", ""))
+         local output = run.luarocks("make --frozen --tree=lua_modules")
+         assert.match("Build dependency a_build_dep", output, 1, true)
+         assert.is.falsy(lfs.attributes(rocks_dir .. "/a_rock"))
+
+         write_file("luarocks.lock", lockfile:format(
+            [[z_build_dep = { ["1.0-1"] = { url = "]] .. a_repo .. [[/z_build_dep-1.0-1.unknown-arch.rock", sha256 = "00" } },]],
+            [[z_build_dep = "1.0-1",]]))
+         output = run.luarocks("make --frozen --tree=lua_modules")
+         assert.match("is built for unknown-arch", output, 1, true)
+
+         write_file("luarocks.lock", lockfile:format(
+            [[a_build_dep = { ["1.0-1"] = ]] .. artifact("a_build_dep-1.0-1.src.rock") .. [[ },]],
+            [[a_build_dep = "1.0-1",]]))
+         assert.is_true(run.luarocks_bool("make --frozen --tree=lua_modules"))
+         assert.is.truthy(lfs.attributes(rocks_dir .. "/has_build_dep/1.0-1"))
+      end, finally)
+   end)
+
    describe("#ddt upgrading rockspecs with double deploy types", function()
       local deploy_lib_dir = testing_paths.testing_sys_tree .. "/lib/lua/"..env_variables.LUA_VERSION
       local deploy_lua_dir = testing_paths.testing_sys_tree .. "/share/lua/"..env_variables.LUA_VERSION
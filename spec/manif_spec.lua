@@ -0,0 +1,182 @@
+local test_env = require("spec.util.test_env")
+
+local lfs = require("lfs")
+local testing_paths = test_env.testing_paths
+local get_tmp_path = test_env.get_tmp_path
+
+describe("loading remote manifests #integration #mock", function()
+
+   local cfg, fs, manif, core_manif, writer, persist, fetch, queries, search
+   local repo, cache
+   local local_cache, cache_timeout
+   local url = "http://localhost:8081"
+
+   lazy_setup(function()
+      test_env.setup_specs(nil, "mock")
+      cfg = require("luarocks.core.cfg")
+      fs = require("luarocks.fs")
+      cfg.init()
+      fs.init()
+      manif = require("luarocks.manif")
+      core_manif = require("luarocks.core.manif")
+      writer = require("luarocks.manif.writer")
+      persist = require("luarocks.persist")
+      fetch = require("luarocks.fetch")
+      queries = require("luarocks.queries")
+      repo = get_tmp_path()
+      lfs.mkdir(repo)
+      test_env.conditional_server_init(repo)
+   end)
+
+   lazy_teardown(function()
+      test_env.conditional_server_done()
+      fs.delete(repo)
+   end)
+
+   local function add_rock(name)
+      assert(fs.copy(testing_paths.fixtures_dir .. "/" .. name, repo .. "/" .. name))
+   end
+
+   before_each(function()
+      for _, file in ipairs(fs.list_dir(repo)) do
+         fs.delete(repo .. "/" .. file)
+      end
+      add_rock("a_rock-1.0-1.src.rock")
+      cache = get_tmp_path()
+      lfs.mkdir(cache)
+      local_cache, cache_timeout = cfg.local_cache, cfg.cache_timeout
+      cfg.local_cache = cache
+      cfg.cache_timeout = 0
+   end)
+
+   after_each(function()
+      cfg.local_cache, cfg.cache_timeout = local_cache, cache_timeout
+      fs.delete(cache)
+   end)
+
+   -- Forget the manifests loaded by this process and when the cached
+   -- files were last checked with the server, as a new run would.
+   local function new_run()
+      core_manif.cache_manifest(url, cfg.lua_version, nil)
+      package.loaded["luarocks.manif"] = nil
+      package.loaded["luarocks.search"] = nil
+      manif = require("luarocks.manif")
+      search = require("luarocks.search")
+      for _, file in ipairs(fs.find(cache)) do
+         if file:match("%.check$") then
+            os.remove(cache .. "/" .. file)
+         end
+      end
+   end
+
+   local function load()
+      new_run()
+      return manif.load_manifest(url)
+   end
+
+   local function delete_manifests()
+      for _, file in ipairs(fs.list_dir(repo)) do
+         if file:match("^manifest") and not file:match("%.deltas$") and not file:match("%.shards$") then
+            fs.delete(repo .. "/" .. file)
+         end
+      end
+   end
+
+   describe("with deltas", function()
+      local function publish()
+         assert(writer.make_manifest(repo, "one", true, nil, 2))
+      end
+
+      before_each(function()
+         publish()
+         assert.truthy(load())
+         add_rock("build_only_deps-0.1-1.src.rock")
+         publish()
+      end)
+
+      it("brings the cached manifest up to date with a delta", function()
+         -- only the delta can bring the cached copy up to date
+         delete_manifests()
+         local manifest = assert(load())
+         assert.truthy(manifest.repository.build_only_deps["0.1-1"])
+         assert.truthy(manifest.repository.a_rock["1.0-1"])
+      end)
+
+      it("downloads the whole manifest when the result does not match the published revision", function()
+         local deltas_dir = repo .. "/" .. manif.deltas_dir(cfg.lua_version)
+         local index = persist.load_into_table(deltas_dir .. "/" .. manif.delta_index_file)
+         local delta_file = deltas_dir .. "/" .. index.deltas[1] .. ".delta"
+         local delta = persist.load_into_table(delta_file)
+         delta.repository.build_only_deps = { ["0.0-1"] = { { arch = "src" } } }
+         assert(persist.save_from_table(delta_file, delta))
+
+         local manifest = assert(load())
+         assert.truthy(manifest.repository.build_only_deps["0.1-1"])
+         assert.is_nil(manifest.repository.build_only_deps["0.0-1"])
+      end)
+
+      it("downloads the whole manifest when the server has no delta from the cached revision", function()
+         local cached = fetch.cache_pathname(url .. "/manifest-" .. cfg.lua_version)
+         local fd = assert(io.open(cached, "a"))
+         fd:write("\n-- edited\n")
+         fd:close()
+
+         local manifest = assert(load())
+         assert.truthy(manifest.repository.build_only_deps["0.1-1"])
+         assert.same(fs.get_md5(repo .. "/manifest-" .. cfg.lua_version), fs.get_md5(cached))
+      end)
+   end)
+
+   describe("with shards", function()
+      local rocks_servers
+
+      before_each(function()
+         add_rock("build_only_deps-0.1-1.src.rock")
+         rocks_servers = cfg.rocks_servers
+         cfg.rocks_servers = { url }
+      end)
+
+      after_each(function()
+         cfg.rocks_servers = rocks_servers
+         cfg.disabled_servers[url] = nil
+      end)
+
+      local function search_versions(name)
+         new_run()
+         return search.search_repos(queries.new(name))[name]
+      end
+
+      it("are written by make_manifest for each package", function()
+         assert(writer.make_manifest(repo, "one", true, true))
+         local shards_dir = repo .. "/" .. manif.shards_dir(cfg.lua_version)
+         local index = persist.load_into_table(shards_dir .. "/" .. manif.shard_index_file)
+         assert.same({ a_rock = true, build_only_deps = true }, index.packages)
+         local shard = persist.load_into_table(shards_dir .. "/" .. manif.shard_file("a_rock"))
+         local manifest = persist.load_into_table(repo .. "/manifest-" .. cfg.lua_version)
+         assert.same({ a_rock = manifest.repository.a_rock }, shard.repository)
+      end)
+
+      it("serve searches for a package by its exact name", function()
+         assert(writer.make_manifest(repo, "one", true, true))
+         -- only the shards can answer
+         delete_manifests()
+         local versions = search_versions("a_rock")
+         assert.truthy(versions and versions["1.0-1"])
+      end)
+
+      it("are not needed to search a server", function()
+         assert(writer.make_manifest(repo, "one", true))
+         assert.falsy(fs.exists(repo .. "/" .. manif.shards_dir(cfg.lua_version)))
+         local versions = search_versions("a_rock")
+         assert.truthy(versions and versions["1.0-1"])
+      end)
+
+      it("fall back to the whole manifest when a shard cannot be fetched", function()
+         assert(writer.make_manifest(repo, "one", true, true))
+         os.remove(repo .. "/" .. manif.shards_dir(cfg.lua_version) .. "/" .. manif.shard_file("a_rock"))
+         local versions = search_versions("a_rock")
+         assert.truthy(versions and versions["1.0-1"])
+         assert.falsy(cfg.disabled_servers[url])
+      end)
+   end)
+end)
@@ -13,6 +13,8 @@ local fs = require("luarocks.fs")
 local path = require("luarocks.path")
 local rockspecs = require("luarocks.rockspecs")
 local build_builtin = require("luarocks.build.builtin")
+local build_cmake = require("luarocks.build.cmake")
+local util = require("luarocks.util")
 
 local c_module_source = [[
    #include <lua.h>
@@ -365,4 +367,75 @@ describe("LuaRocks build #unit", function()
          end)
       end)
    end)
+
+   describe("build.cmake", function()
+      local tmpdir
+      local olddir
+
+      before_each(function()
+         tmpdir = get_tmp_path()
+         olddir = lfs.currentdir()
+         lfs.mkdir(tmpdir)
+         lfs.chdir(tmpdir)
+         fs.change_dir(tmpdir)
+         path.use_tree(tmpdir)
+      end)
+
+      after_each(function()
+         if olddir then
+            lfs.chdir(olddir)
+            fs.change_dir(olddir)
+            if tmpdir then
+               fs.delete(tmpdir)
+            end
+         end
+      end)
+
+      it("seeds a second configure with the saved feature check results", function()
+         local local_cache, configure_cache = cfg.local_cache, cfg.cmake_configure_cache
+         local printout = util.printout
+         finally(function()
+            cfg.local_cache, cfg.cmake_configure_cache = local_cache, configure_cache
+            util.printout = printout
+         end)
+         cfg.local_cache = tmpdir .. "/cache"
+         cfg.cmake_configure_cache = true
+         local messages = {}
+         util.printout = function(...)
+            table.insert(messages, table.concat({ ... }, "\t"))
+         end
+
+         local rockspec = {
+            package = "cmake_module",
+            version = "1.0-1",
+            source = {
+               url = "http://example.com/cmake_module"
+            },
+            build = {
+               type = "cmake",
+               cmake = [[
+                  cmake_minimum_required(VERSION 3.5)
+                  project(cmake_module C)
+                  include(CheckIncludeFile)
+                  check_include_file(stdio.h HAVE_STDIO_H)
+               ]]
+            }
+         }
+         rockspecs.from_persisted_table("cmake_module-1.0-1.rockspec", rockspec)
+
+         assert.truthy(build_cmake.run(rockspec, true))
+         local cache_file = tmpdir .. "/cache/cmake/cmake_module-1.0-1.cmake"
+         local fd = assert(io.open(cache_file))
+         local saved = fd:read("*a")
+         fd:close()
+         assert.match("set%(HAVE_STDIO_H ", saved)
+         assert.is_nil(saved:find(tmpdir, 1, true))
+         assert.is_nil(saved:match("CMAKE_C_COMPILER"))
+         assert.same({}, messages)
+
+         fs.delete(tmpdir .. "/build.luarocks")
+         assert.truthy(build_cmake.run(rockspec, true))
+         assert.same({ "Using cached configure results from " .. cache_file }, messages)
+      end)
+   end)
 end)
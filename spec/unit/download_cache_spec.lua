@@ -0,0 +1,117 @@
+local test_env = require("spec.util.test_env")
+local get_tmp_path = test_env.get_tmp_path
+local testing_paths = test_env.testing_paths
+local write_file = test_env.write_file
+
+local fs = require("luarocks.fs")
+local cfg = require("luarocks.core.cfg")
+local dir = require("luarocks.dir")
+local download_cache = require("luarocks.download_cache")
+
+describe("luarocks.download_cache #unit", function()
+   local runner
+   local tmpdir
+   local saved = {}
+
+   lazy_setup(function()
+      cfg.init()
+      fs.init()
+      runner = require("luacov.runner")
+      runner.init(testing_paths.testrun_dir .. "/luacov.config")
+   end)
+
+   lazy_teardown(function()
+      runner.save_stats()
+   end)
+
+   before_each(function()
+      tmpdir = get_tmp_path()
+      fs.make_dir(tmpdir)
+      saved.local_cache = cfg.local_cache
+      saved.download_cache_size = cfg.download_cache_size
+      saved.rocks_servers = cfg.rocks_servers
+      cfg.rocks_servers = {
+         { "http://example.com/rocks", "http://mirror.example.com/" },
+         "http://other.example.com",
+      }
+      cfg.local_cache = dir.path(tmpdir, "cache")
+      cfg.download_cache_size = 1
+      download_cache.clear()
+   end)
+
+   after_each(function()
+      cfg.local_cache = saved.local_cache
+      cfg.download_cache_size = saved.download_cache_size
+      cfg.rocks_servers = saved.rocks_servers
+      fs.delete(tmpdir)
+   end)
+
+   local function download(name, content)
+      local file = dir.path(tmpdir, name)
+      write_file(file, content, finally)
+      return file
+   end
+
+   it("finds rocks fetched from another mirror of the same server", function()
+      local url = "http://example.com/rocks/a-1.0-1.src.rock"
+      local stored = assert(download_cache.store(url, download("a-1.0-1.src.rock", "rock")))
+      assert.same(stored, download_cache.find(url))
+      assert.same(stored, download_cache.find("http://mirror.example.com/a-1.0-1.src.rock"))
+      assert.is_nil(download_cache.find("http://example.com/rocks/b-1.0-1.src.rock"))
+   end)
+
+   it("does not mix up rocks with the same file name from other servers or namespaces", function()
+      local url = "http://example.com/rocks/a-1.0-1.src.rock"
+      assert(download_cache.store(url, download("a-1.0-1.src.rock", "rock")))
+      assert.is_nil(download_cache.find("http://other.example.com/a-1.0-1.src.rock"))
+      assert.is_nil(download_cache.find("http://example.com/rocks/manifests/user/a-1.0-1.src.rock"))
+      assert.is_nil(download_cache.find("http://unknown.example.com/a-1.0-1.src.rock"))
+   end)
+
+   it("does not return corrupted files", function()
+      local url = "http://example.com/rocks/a-1.0-1.src.rock"
+      local stored = assert(download_cache.store(url, download("a-1.0-1.src.rock", "rock")))
+      write_file(stored, "corrupted", finally)
+      assert.is_nil(download_cache.find(url))
+      assert.is_false(fs.exists(stored))
+   end)
+
+   it("stores identical files once", function()
+      download_cache.store("http://example.com/a-1.0-1.rockspec", download("a-1.0-1.rockspec", "same"))
+      download_cache.store("http://example.com/b-1.0-1.rockspec", download("b-1.0-1.rockspec", "same"))
+      local stats = download_cache.stats()
+      assert.same(1, stats.files)
+      assert.same(2, stats.urls)
+   end)
+
+   it("does not cache development versions", function()
+      local url = "http://example.com/a-scm-1.rockspec"
+      assert.is_nil(download_cache.store(url, download("a-scm-1.rockspec", "dev")))
+      assert.is_nil(download_cache.find(url))
+   end)
+
+   it("reports files it cannot hash when verifying", function()
+      download_cache.store("http://example.com/rocks/a-1.0-1.src.rock", download("a-1.0-1.src.rock", "rock"))
+      local get_checksums = fs.get_checksums
+      fs.get_checksums = function()
+         return nil, "no checksum tool"
+      end
+      local bad, err = download_cache.verify()
+      fs.get_checksums = get_checksums
+      assert.is_nil(bad)
+      assert.match("no checksum tool", err)
+      assert.same(1, download_cache.stats().files)
+   end)
+
+   it("evicts the least recently used files", function()
+      local big = string.rep("x", 400 * 1024)
+      download_cache.store("http://example.com/a-1.0-1.src.rock", download("a-1.0-1.src.rock", big .. "a"))
+      download_cache.store("http://example.com/b-1.0-1.src.rock", download("b-1.0-1.src.rock", big .. "b"))
+      download_cache.store("http://example.com/c-1.0-1.src.rock", download("c-1.0-1.src.rock", big .. "c"))
+      assert.same(2, download_cache.stats().files)
+
+      local removed = download_cache.prune(0)
+      assert.same(2, removed)
+      assert.same(0, download_cache.stats().files)
+   end)
+end)
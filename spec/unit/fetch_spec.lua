@@ -165,6 +165,49 @@ describe("luarocks fetch #unit", function()
       end)
    end)
 
+   describe("fetch.prefetch", function()
+
+      it("downloads the files into the cache, where they are found when fetched", function()
+         test_env.run_in_tmp(function(tmpdir)
+            local local_cache, download_jobs = cfg.local_cache, cfg.download_jobs
+            local download, download_parallel = fs.download, fs.download_parallel
+            finally(function()
+               cfg.local_cache, cfg.download_jobs = local_cache, download_jobs
+               fs.download, fs.download_parallel = download, download_parallel
+            end)
+            cfg.local_cache = tmpdir
+            cfg.download_jobs = 2
+
+            local reported = {}
+            fs.download_parallel = function(downloads, jobs, report)
+               local failed = {}
+               for _, d in ipairs(downloads) do
+                  if not fs.download(d.url, d.filename) then
+                     failed[d.url] = "failed downloading " .. d.url
+                  end
+                  report(d.url, not failed[d.url], failed[d.url])
+                  reported[d.url] = not failed[d.url]
+               end
+               return failed
+            end
+
+            local url = "http://localhost:8080/file/a_rock.lua"
+            local missing = "http://localhost:8080/file/nonexistent"
+            fetch.prefetch({ url, missing, url })
+            assert.same({ [url] = true, [missing] = false }, reported)
+            assert.truthy(lfs.attributes(fetch.cache_pathname(url)))
+
+            fs.download = function()
+               return nil, "unexpected download"
+            end
+            local fetchedfile, dirname = fetch.fetch_url_at_temp_dir(url, "test", "my_a_rock.lua")
+            assert(fetchedfile, dirname)
+            assert.truthy(are_same_files(fetchedfile, dirname .. "/my_a_rock.lua"))
+            assert.falsy(fetch.fetch_url_at_temp_dir(missing, "test"))
+         end, finally)
+      end)
+   end)
+
    describe("fetch.find_base_dir", function()
       it("extracts the archive given by the file argument and returns the inferred and the actual root directory in the archive", function()
          test_env.run_in_tmp(function()
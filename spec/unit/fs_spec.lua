@@ -140,6 +140,36 @@ describe("luarocks.fs #unit", function()
       end)
    end)
 
+   describe("fs.execute_parallel", function()
+      it("runs the commands and reports their status and output in order", function()
+         local reported = {}
+         local ok = fs.execute_parallel({ "echo one", "echo two", "echo three" }, 2, function(i, success, output)
+            reported[i] = { success, (output:gsub("%s+$", "")) }
+         end)
+         assert.truthy(ok)
+         assert.same({ { true, "one" }, { true, "two" }, { true, "three" } }, reported)
+      end)
+
+      it("stops starting commands after the report function returns false", function()
+         local reported = {}
+         local ok = fs.execute_parallel({ "echo one", "invalidcommand", "echo three", "echo four" }, 1, function(i, success)
+            reported[i] = success
+            return success
+         end)
+         assert.falsy(ok)
+         assert.same({ true, false }, reported)
+      end)
+
+      it("runs the commands one at a time when given less than one job", function()
+         local reported = {}
+         local ok = fs.execute_parallel({ "echo one", "echo two" }, 0, function(i, success)
+            reported[i] = success
+         end)
+         assert.truthy(ok)
+         assert.same({ true, true }, reported)
+      end)
+   end)
+
    describe("fs.dir_iterator", function()
       local tmpfile1
       local tmpfile2
@@ -380,6 +410,35 @@ describe("luarocks.fs #unit", function()
       end)
    end)
 
+   describe("fs.set_permissions_many", function()
+      local files = {}
+
+      after_each(function()
+         for _, file in ipairs(files) do
+            os.remove(file)
+         end
+         files = {}
+      end)
+
+      it("sets the permissions of all the files", function()
+         for i = 1, 3 do
+            files[i] = get_tmp_path()
+            create_file(files[i])
+            make_unreadable(files[i])
+            assert.falsy(io.open(files[i], "r"))
+         end
+         assert.truthy(fs.set_permissions_many(files, "read", "user"))
+         for _, file in ipairs(files) do
+            local fd = assert(io.open(file, "r"))
+            fd:close()
+         end
+      end)
+
+      it("returns false if a file is nonexistent", function()
+         assert.falsy(fs.set_permissions_many({ "/nonexistent" }, "read", "user"))
+      end)
+   end)
+
    describe("fs.is_file", function()
       local tmpfile
       local tmpdir
@@ -1281,6 +1340,41 @@ describe("luarocks.fs #unit", function()
       end)
    end)
 
+   describe("fs.get_checksums", function()
+      local tmpdir
+
+      before_each(function()
+         tmpdir = get_tmp_path()
+         lfs.mkdir(tmpdir)
+      end)
+
+      after_each(function()
+         if tmpdir then
+            fs.delete(tmpdir)
+         end
+      end)
+
+      it("returns the checksums of all files at once", function()
+         local files = {}
+         for i = 1, 300 do
+            files[i] = tmpdir .. "/file " .. i .. ".txt"
+            create_file(files[i], i % 2 == 0 and "foo" or "bar")
+         end
+         local sums = assert(fs.get_checksums(files))
+         for i = 1, 300 do
+            assert.same(i % 2 == 0 and "acbd18db4cc2f85cedef654fccc4a4d8" or "37b51d194a7513e45b56f6524f2d51f2", sums[files[i]])
+         end
+         sums = assert(fs.get_checksums({ files[2] }, "sha256"))
+         assert.same("2c26b46b68ffc68ff99b453c1d30413413422d706483bfa0f98a5e886266e7ae", sums[files[2]])
+      end)
+
+      it("fails if a file cannot be read", function()
+         local file = tmpdir .. "/file.txt"
+         create_file(file)
+         assert.falsy(fs.get_checksums({ file, tmpdir .. "/nonexistent" }))
+      end)
+   end)
+
    describe("fs.zip", function()
       local tmpdir
       local olddir
@@ -1334,6 +1428,37 @@ describe("luarocks.fs #unit", function()
 
    end)
 
+   describe("fs.unpack_archive", function()
+      local tmpdir
+      local olddir
+
+      before_each(function()
+         olddir = lfs.currentdir()
+         tmpdir = get_tmp_path()
+         lfs.mkdir(tmpdir)
+         chdir(tmpdir)
+      end)
+
+      after_each(function()
+         if olddir then
+            chdir(olddir)
+            if tmpdir then
+               fs.delete(tmpdir)
+            end
+         end
+      end)
+
+      it("unpacks a .tar.gz archive without leaving the .tar file", function()
+         local archive = tmpdir .. "/an_upstream_tarball-0.1.tar.gz"
+         assert.truthy(fs.copy(testing_paths.fixtures_dir .. "/an_upstream_tarball-0.1.tar.gz", archive))
+         assert.truthy(fs.unpack_archive(archive))
+         assert.truthy(exists_file("an_upstream_tarball-0.1/src/my_module.lua"))
+         if pcall(require, "zlib") then
+            assert.falsy(exists_file("an_upstream_tarball-0.1.tar"))
+         end
+      end)
+   end)
+
    describe("fs.unzip", function()
       local tmpdir
       local olddir
@@ -1389,6 +1514,54 @@ describe("luarocks.fs #unit", function()
       it("does nothing if the given archive is invalid", function()
          assert.falsy(fs.unzip("archive.zip"))
       end)
+
+      it("extracts files larger than a read chunk with the Lua implementation", function()
+         local zip = require("luarocks.tools.zip")
+         local lines = {}
+         for i = 1, 20000 do
+            lines[i] = "line " .. i
+         end
+         local content = table.concat(lines, "\n")
+         write_file("dir/file3", content, finally)
+         assert.truthy(zip.zip("archive.zip", "dir"))
+         os.remove("dir/file3")
+
+         assert.truthy(zip.unzip("archive.zip"))
+         local fd = assert(io.open("dir/file3", "rb"))
+         assert.same(content, fd:read("*a"))
+         fd:close()
+         os.remove("archive.zip")
+      end)
+
+      it("extracts single files with the Lua implementation", function()
+         local zip = require("luarocks.tools.zip")
+         assert.truthy(zip.zip("archive.zip", "file1", "file2"))
+         os.remove("file1")
+         os.remove("file2")
+
+         local zr = assert(zip.new_zipreader("archive.zip"))
+         assert.same({ "file1", "file2" }, zr:list())
+         assert.truthy(zr:extract("file2"))
+         assert.falsy(zr:extract("file3"))
+         zr:close()
+         assert.falsy(exists_file("file1"))
+         assert.truthy(exists_file("file2"))
+         os.remove("archive.zip")
+      end)
+
+      it("extracts the files found even if others are missing", function()
+         local zip = require("luarocks.tools.zip")
+         assert.truthy(zip.zip("archive.zip", "file1", "file2"))
+         os.remove("file1")
+         os.remove("file2")
+
+         local ok, err = zip.unzip("archive.zip", "file3", "file2")
+         assert.falsy(ok)
+         assert.match("file3", err)
+         assert.falsy(exists_file("file1"))
+         assert.truthy(exists_file("file2"))
+         os.remove("archive.zip")
+      end)
    end)
 
    describe("fs.wrap_script", function()
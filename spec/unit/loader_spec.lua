@@ -1,5 +1,6 @@
 local test_env = require("spec.util.test_env")
 local run = test_env.run
+local write_file = test_env.write_file
 
 test_env.setup_specs()
 
@@ -14,5 +15,54 @@ describe("luarocks.loader", function()
             assert(run.lua_bool([[-e "loader = require 'luarocks.loader'; local x,y,z,p = loader.which('luarocks.loader', 'p'); assert(p == 'p')"]]))
          end)
       end)
+
+      describe("add_context", function()
+         -- rock a 1.0-1 depends on rock b, and its closure pins b 1.0-1
+         local function add_context(installed_b)
+            return [[
+               local manif = require("luarocks.core.manif")
+               local scanned = false
+               manif.load_rocks_tree_module_indexes = function()
+                  local b = {}
+                  for _, v in ipairs({ ]] .. installed_b .. [[ }) do
+                     b[v] = {}
+                  end
+                  return { { index = { modules = {}, dependencies = {
+                     a = { ["1.0-1"] = { b = "1.0-1" } },
+                     b = b,
+                  } } } }
+               end
+               manif.load_rocks_tree_manifests = function()
+                  scanned = true
+                  local repository = { a = { ["1.0-1"] = {} }, b = {} }
+                  for _, v in ipairs({ ]] .. installed_b .. [[ }) do
+                     repository.b[v] = {}
+                  end
+                  return { { manifest = { repository = repository, dependencies = {
+                     a = { ["1.0-1"] = { { name = "b" } } },
+                  } } } }
+               end
+               local loader = require("luarocks.loader")
+               loader.add_context("a", "1.0-1")
+               print("CONTEXT " .. tostring(loader.context.b) .. " SCANNED " .. tostring(scanned))
+            ]]
+         end
+
+         it("uses the dependency closure of the rock", function()
+            test_env.run_in_tmp(function(tmpdir)
+               write_file("add_context.lua", add_context([["1.0-1", "2.0-1"]]))
+               local output = run.lua("add_context.lua")
+               assert.matches("CONTEXT 1.0-1 SCANNED false", output, 1, true)
+            end, finally)
+         end)
+
+         it("scans dependencies when a version pinned by the closure is not installed", function()
+            test_env.run_in_tmp(function(tmpdir)
+               write_file("add_context.lua", add_context([["2.0-1"]]))
+               local output = run.lua("add_context.lua")
+               assert.matches("CONTEXT 2.0-1 SCANNED true", output, 1, true)
+            end, finally)
+         end)
+      end)
    end)
 end)
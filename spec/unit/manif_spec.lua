@@ -0,0 +1,227 @@
+local test_env = require("spec.util.test_env")
+local testing_paths = test_env.testing_paths
+
+local manif = require("luarocks.manif")
+local core_manif = require("luarocks.core.manif")
+local persist = require("luarocks.persist")
+local lfs = require("lfs")
+
+local function deep_copy(t)
+   if type(t) ~= "table" then
+      return t
+   end
+   local copy = {}
+   for k, v in pairs(t) do
+      copy[k] = deep_copy(v)
+   end
+   return copy
+end
+
+describe("luarocks.manif #unit", function()
+   local runner
+
+   lazy_setup(function()
+      runner = require("luacov.runner")
+      runner.init(testing_paths.testrun_dir .. "/luacov.config")
+   end)
+
+   lazy_teardown(function()
+      runner.save_stats()
+   end)
+
+   describe("manif.make_delta", function()
+      local old = {
+         repository = {
+            foo = { ["1.0-1"] = { { arch = "rockspec" } } },
+            bar = { ["1.0-1"] = { { arch = "rockspec" } } },
+            baz = { ["1.0-1"] = { { arch = "src" } } },
+         },
+         modules = {},
+         commands = {},
+      }
+      local new = {
+         repository = {
+            foo = { ["1.0-1"] = { { arch = "rockspec" } } },
+            bar = { ["1.0-1"] = { { arch = "rockspec" } }, ["2.0-1"] = { { arch = "rockspec" } } },
+            qux = { ["0.1-1"] = { { arch = "all" } } },
+         },
+         modules = {},
+         commands = {},
+      }
+
+      it("only lists changed entries", function()
+         local delta = manif.make_delta(old, new)
+         assert.is_nil(delta.repository.foo)
+         assert.same(new.repository.bar, delta.repository.bar)
+         assert.same(new.repository.qux, delta.repository.qux)
+         assert.is_false(delta.repository.baz)
+      end)
+
+      it("reproduces the new manifest when applied", function()
+         local delta = manif.make_delta(old, new)
+         local copy = deep_copy(old)
+         manif.apply_delta(copy, delta)
+         assert.same(persist.save_from_table_to_string(new), persist.save_from_table_to_string(copy))
+      end)
+   end)
+
+   describe("manifest journal", function()
+      it("is applied in order when loading a tree manifest", function()
+         local tmpdir = os.tmpname()
+         os.remove(tmpdir)
+         assert(lfs.mkdir(tmpdir))
+
+         local fd = assert(io.open(tmpdir .. "/manifest", "w"))
+         fd:write(persist.save_from_table_to_string({
+            repository = {
+               foo = { ["1.0-1"] = { { arch = "installed", modules = { foo = "foo.lua" } } } },
+            },
+            modules = { foo = { "foo/1.0-1" } },
+            commands = {},
+         }))
+         fd:write(manif.manifest_stamp_line("abcd"))
+         fd:close()
+         fd = assert(io.open(tmpdir .. "/" .. manif.journal_file, "w"))
+         fd:write(manif.journal_header_line("abcd"))
+         fd:write(persist.save_from_table_to_string({ entry = {
+            repository = { bar = { ["1.0-1"] = { { arch = "installed", modules = { bar = "bar.lua" } } } } },
+            modules = { bar = { "bar/1.0-1" } },
+         } }))
+         fd:write(persist.save_from_table_to_string({ entry = {
+            repository = { foo = false },
+            modules = { foo = false },
+         } }))
+         fd:write(manif.manifest_stamp_line("1234"))
+         fd:close()
+
+         local manifest = assert(core_manif.manifest_loader(tmpdir .. "/manifest", tmpdir, test_env.lua_version))
+         assert.is_nil(manifest.repository.foo)
+         assert.is_nil(manifest.modules.foo)
+         assert.same({ "bar/1.0-1" }, manifest.modules.bar)
+         assert.same({}, manifest.commands)
+
+         os.remove(tmpdir .. "/" .. manif.journal_file)
+         os.remove(tmpdir .. "/manifest")
+         lfs.rmdir(tmpdir)
+      end)
+
+      it("is applied when the manifest was rewritten by a tool that does not know about it", function()
+         local tmpdir = os.tmpname()
+         os.remove(tmpdir)
+         assert(lfs.mkdir(tmpdir))
+
+         -- the manifest was rewritten without a stamp, leaving out the
+         -- rocks installed since the journal was started
+         local fd = assert(io.open(tmpdir .. "/manifest", "w"))
+         fd:write(persist.save_from_table_to_string({
+            repository = {},
+            modules = {},
+            commands = {},
+         }))
+         fd:close()
+         fd = assert(io.open(tmpdir .. "/" .. manif.journal_file, "w"))
+         fd:write(manif.journal_header_line("abcd"))
+         fd:write(persist.save_from_table_to_string({ entry = {
+            repository = { bar = { ["1.0-1"] = { { arch = "installed", modules = { bar = "bar.lua" } } } } },
+            modules = { bar = { "bar/1.0-1" } },
+         } }))
+         fd:close()
+         fd = assert(io.open(tmpdir .. "/" .. manif.loader_index_file, "w"))
+         fd:write(persist.save_from_table_to_string({
+            stamp = "abcd",
+            modules = {},
+            dependencies = {},
+         }))
+         fd:close()
+
+         assert.is_true(core_manif.journal_is_orphaned(tmpdir))
+         local manifest = assert(core_manif.manifest_loader(tmpdir .. "/manifest", tmpdir, test_env.lua_version))
+         assert.same({ "bar/1.0-1" }, manifest.modules.bar)
+         -- the index does not match the manifest, so it is built from it
+         local index = assert(core_manif.fast_load_local_module_index(tmpdir))
+         assert.is_nil(index.stamp)
+         assert.same({ { "bar", "1.0-1", "bar.lua" } }, index.modules.bar)
+
+         os.remove(tmpdir .. "/" .. manif.loader_index_file)
+         os.remove(tmpdir .. "/" .. manif.journal_file)
+         os.remove(tmpdir .. "/manifest")
+         lfs.rmdir(tmpdir)
+      end)
+
+      it("is ignored when it was started on an earlier manifest", function()
+         local tmpdir = os.tmpname()
+         os.remove(tmpdir)
+         assert(lfs.mkdir(tmpdir))
+
+         -- the journal was left behind when the manifest was written in full
+         local fd = assert(io.open(tmpdir .. "/manifest", "w"))
+         fd:write(persist.save_from_table_to_string({
+            repository = {},
+            modules = {},
+            commands = {},
+         }))
+         fd:write(manif.manifest_stamp_line("1234"))
+         fd:close()
+         fd = assert(io.open(tmpdir .. "/" .. manif.journal_file, "w"))
+         fd:write(manif.journal_header_line("abcd"))
+         fd:write(persist.save_from_table_to_string({ entry = {
+            repository = { bar = { ["1.0-1"] = { { arch = "installed", modules = { bar = "bar.lua" } } } } },
+            modules = { bar = { "bar/1.0-1" } },
+         } }))
+         fd:close()
+
+         assert.is_false(core_manif.journal_is_orphaned(tmpdir))
+         local manifest = assert(core_manif.manifest_loader(tmpdir .. "/manifest", tmpdir, test_env.lua_version))
+         assert.is_nil(manifest.repository.bar)
+         assert.is_nil(manifest.modules.bar)
+
+         os.remove(tmpdir .. "/" .. manif.journal_file)
+         os.remove(tmpdir .. "/manifest")
+         lfs.rmdir(tmpdir)
+      end)
+
+      it("is applied to the loader index", function()
+         local tmpdir = os.tmpname()
+         os.remove(tmpdir)
+         assert(lfs.mkdir(tmpdir))
+
+         local fd = assert(io.open(tmpdir .. "/manifest", "w"))
+         fd:write(persist.save_from_table_to_string({
+            repository = {
+               foo = { ["1.0-1"] = { { arch = "installed", modules = { foo = "foo.lua" }, dependencies = {} } } },
+            },
+            modules = { foo = { "foo/1.0-1" } },
+            commands = {},
+         }))
+         fd:write(manif.manifest_stamp_line("abcd"))
+         fd:close()
+         fd = assert(io.open(tmpdir .. "/" .. manif.loader_index_file, "w"))
+         fd:write(persist.save_from_table_to_string({
+            stamp = "abcd",
+            modules = { foo = { { "foo", "1.0-1", "foo.lua" } } },
+            dependencies = { foo = { ["1.0-1"] = {} } },
+         }))
+         fd:close()
+         -- bar 1.0-1, which depends on foo, also provides the foo module
+         fd = assert(io.open(tmpdir .. "/" .. manif.journal_file, "w"))
+         fd:write(manif.journal_header_line("abcd"))
+         fd:write(persist.save_from_table_to_string({ entry = {
+            repository = { bar = { ["1.0-1"] = { { arch = "installed", modules = { bar = "bar.lua", foo = "bar/foo.lua" }, dependencies = { foo = "1.0-1" } } } } },
+            modules = { bar = { "bar/1.0-1" }, foo = { "bar/1.0-1", "foo/1.0-1" } },
+         } }))
+         fd:close()
+
+         local index = assert(core_manif.fast_load_local_module_index(tmpdir))
+         assert.same("abcd", index.stamp)
+         assert.same({ { "bar", "1.0-1", "bar.lua" } }, index.modules.bar)
+         assert.same({ { "bar", "1.0-1", "bar/foo.lua" }, { "foo", "1.0-1", "foo.lua" } }, index.modules.foo)
+         assert.same({ ["1.0-1"] = { foo = "1.0-1" } }, index.dependencies.bar)
+         assert.same({ ["1.0-1"] = {} }, index.dependencies.foo)
+
+         os.remove(tmpdir .. "/" .. manif.loader_index_file)
+         os.remove(tmpdir .. "/" .. manif.journal_file)
+         os.remove(tmpdir .. "/manifest")
+         lfs.rmdir(tmpdir)
+      end)
+   end)
+end)
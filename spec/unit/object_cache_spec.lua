@@ -0,0 +1,84 @@
+local test_env = require("spec.util.test_env")
+local get_tmp_path = test_env.get_tmp_path
+local testing_paths = test_env.testing_paths
+local write_file = test_env.write_file
+
+local fs = require("luarocks.fs")
+local cfg = require("luarocks.core.cfg")
+local dir = require("luarocks.dir")
+local object_cache = require("luarocks.tools.object_cache")
+
+describe("luarocks.tools.object_cache #unit", function()
+   local runner
+   local tmpdir
+
+   lazy_setup(function()
+      cfg.init()
+      fs.init()
+      runner = require("luacov.runner")
+      runner.init(testing_paths.testrun_dir .. "/luacov.config")
+   end)
+
+   lazy_teardown(function()
+      runner.save_stats()
+   end)
+
+   before_each(function()
+      tmpdir = get_tmp_path()
+      fs.make_dir(tmpdir)
+   end)
+
+   after_each(function()
+      fs.delete(tmpdir)
+   end)
+
+   local function key_of(source, command)
+      local preprocessed = dir.path(tmpdir, "source.i")
+      write_file(preprocessed, source, finally)
+      return object_cache.key(preprocessed, command)
+   end
+
+   it("changes the key with the source and the command line", function()
+      local key = key_of("int f(void) { return 1; }", "cc -c a.c -o a.o")
+      assert.same(key, key_of("int f(void) { return 1; }", "cc -c a.c -o a.o"))
+      assert.are_not.same(key, key_of("int f(void) { return 2; }", "cc -c a.c -o a.o"))
+      assert.are_not.same(key, key_of("int f(void) { return 1; }", "cc -O2 -c a.c -o a.o"))
+   end)
+
+   it("returns stored objects and counts hits and misses", function()
+      local cache = assert(object_cache.open(dir.path(tmpdir, "cache")))
+      local object = dir.path(tmpdir, "a.o")
+      local key = key_of("int f(void) { return 1; }", "cc -c a.c -o a.o")
+
+      assert.falsy(object_cache.fetch(cache, key, object))
+      write_file(object, "compiled", finally)
+      object_cache.store(cache, key, object)
+      os.remove(object)
+
+      assert.truthy(object_cache.fetch(cache, key, object))
+      assert.same("compiled", io.open(object):read("*a"))
+      assert.same(1, cache.hits)
+      assert.same(1, cache.misses)
+   end)
+
+   it("evicts the least recently used objects", function()
+      local cache_dir = dir.path(tmpdir, "cache")
+      local object = dir.path(tmpdir, "a.o")
+      write_file(object, string.rep("x", 600 * 1024), finally)
+
+      local keys = {}
+      for i = 1, 3 do
+         local cache = assert(object_cache.open(cache_dir))
+         keys[i] = key_of("int f(void) { return " .. i .. "; }", "cc -c a.c -o a.o")
+         object_cache.fetch(cache, keys[i], dir.path(tmpdir, "b.o"))
+         object_cache.store(cache, keys[i], object)
+         cache.used[keys[i]] = i
+         object_cache.close(cache, 1)
+      end
+
+      local cache = assert(object_cache.open(cache_dir))
+      assert.falsy(object_cache.fetch(cache, keys[1], dir.path(tmpdir, "b.o")))
+      assert.falsy(object_cache.fetch(cache, keys[2], dir.path(tmpdir, "b.o")))
+      assert.truthy(object_cache.fetch(cache, keys[3], dir.path(tmpdir, "b.o")))
+   end)
+end)
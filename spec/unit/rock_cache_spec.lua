@@ -0,0 +1,68 @@
+local test_env = require("spec.util.test_env")
+local get_tmp_path = test_env.get_tmp_path
+local testing_paths = test_env.testing_paths
+local write_file = test_env.write_file
+
+local fs = require("luarocks.fs")
+local cfg = require("luarocks.core.cfg")
+local dir = require("luarocks.dir")
+local rock_cache = require("luarocks.rock_cache")
+
+describe("luarocks.rock_cache #unit", function()
+   local runner
+   local tmpdir
+
+   lazy_setup(function()
+      cfg.init()
+      fs.init()
+      runner = require("luacov.runner")
+      runner.init(testing_paths.testrun_dir .. "/luacov.config")
+   end)
+
+   lazy_teardown(function()
+      runner.save_stats()
+   end)
+
+   before_each(function()
+      tmpdir = get_tmp_path()
+      fs.make_dir(tmpdir)
+      cfg.binary_rock_cache_dir = dir.path(tmpdir, "cache")
+   end)
+
+   after_each(function()
+      cfg.binary_rock_cache_dir = nil
+      fs.delete(tmpdir)
+   end)
+
+   local function new_rockspec(version, cflags)
+      local filename = dir.path(tmpdir, "a-" .. version .. ".rockspec")
+      write_file(filename, "package = 'a'\nversion = '" .. version .. "'\n", finally)
+      return {
+         name = "a",
+         version = version,
+         local_abs_filename = filename,
+         variables = { CC = "cc", CFLAGS = cflags },
+      }
+   end
+
+   it("keys rocks by their build inputs", function()
+      local entry = rock_cache.entry_dir(new_rockspec("1.0-1", "-O2"))
+      assert.truthy(entry)
+      assert.same(entry, rock_cache.entry_dir(new_rockspec("1.0-1", "-O2")))
+      assert.are_not.same(entry, rock_cache.entry_dir(new_rockspec("1.0-1", "-O0")))
+      assert.are_not.same(entry, rock_cache.entry_dir(new_rockspec("1.0-2", "-O2")))
+   end)
+
+   it("does not cache development versions", function()
+      assert.is_nil(rock_cache.entry_dir(new_rockspec("scm-1", "-O2")))
+      assert.is_nil(rock_cache.entry_dir(new_rockspec("dev-1", "-O2")))
+   end)
+
+   it("finds stored rocks", function()
+      local entry = rock_cache.entry_dir(new_rockspec("1.0-1", "-O2"))
+      assert.is_nil(rock_cache.find(entry))
+      fs.make_dir(entry)
+      write_file(dir.path(entry, "a-1.0-1.all.rock"), "", finally)
+      assert.same(dir.path(entry, "a-1.0-1.all.rock"), rock_cache.find(entry))
+   end)
+end)
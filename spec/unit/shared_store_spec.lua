@@ -0,0 +1,72 @@
+local test_env = require("spec.util.test_env")
+local get_tmp_path = test_env.get_tmp_path
+local testing_paths = test_env.testing_paths
+local write_file = test_env.write_file
+
+local lfs = require("lfs")
+local fs = require("luarocks.fs")
+local cfg = require("luarocks.core.cfg")
+local dir = require("luarocks.dir")
+local shared_store = require("luarocks.shared_store")
+
+describe("luarocks.shared_store #unit #unix", function()
+   local runner
+   local tmpdir
+
+   lazy_setup(function()
+      cfg.init()
+      fs.init()
+      runner = require("luacov.runner")
+      runner.init(testing_paths.testrun_dir .. "/luacov.config")
+   end)
+
+   lazy_teardown(function()
+      runner.save_stats()
+   end)
+
+   before_each(function()
+      tmpdir = get_tmp_path()
+      fs.make_dir(dir.path(tmpdir, "a"))
+      fs.make_dir(dir.path(tmpdir, "b"))
+      cfg.shared_store_dir = dir.path(tmpdir, "store")
+      cfg.shared_store_link = "hardlink"
+   end)
+
+   after_each(function()
+      cfg.shared_store_dir = nil
+      cfg.shared_store_link = "auto"
+      fs.delete(tmpdir)
+   end)
+
+   local function deploy(tree, name, content)
+      local file = dir.path(tmpdir, tree, name)
+      write_file(file, content, finally)
+      return file
+   end
+
+   it("links the files of several trees to one stored copy", function()
+      local a = deploy("a", "mod.lua", "return 1")
+      local b = deploy("b", "mod.lua", "return 1")
+      assert.same(1, shared_store.share({ a }, "read"))
+      assert.same(1, shared_store.share({ b }, "read"))
+      assert.same(lfs.attributes(a, "ino"), lfs.attributes(b, "ino"))
+      assert.same(3, lfs.attributes(a, "nlink"))
+      assert.same("r--r--r--", lfs.attributes(a, "permissions"))
+      assert.same(1, shared_store.stats().files)
+   end)
+
+   it("keeps the files shared with other trees when one tree removes them", function()
+      local a = deploy("a", "mod.lua", "return 1")
+      local b = deploy("b", "mod.lua", "return 1")
+      shared_store.share({ a, b }, "read")
+      os.remove(a)
+      assert.same(0, shared_store.prune())
+      local fd = assert(io.open(b))
+      assert.same("return 1", fd:read("*a"))
+      fd:close()
+
+      os.remove(b)
+      assert.same(1, shared_store.prune())
+      assert.same(0, shared_store.stats().files)
+   end)
+end)
@@ -0,0 +1,103 @@
+local test_env = require("spec.util.test_env")
+local testing_paths = test_env.testing_paths
+
+local cfg = require("luarocks.core.cfg")
+local fs = require("luarocks.fs")
+local manif = require("luarocks.manif")
+local search = require("luarocks.search")
+local fetch = require("luarocks.fetch")
+local queries = require("luarocks.queries")
+local solver = require("luarocks.deps.solver")
+
+describe("luarocks.deps.solver #unit", function()
+   local runner
+   local repo
+   local saved = {}
+
+   lazy_setup(function()
+      cfg.init()
+      fs.init()
+
+      runner = require("luacov.runner")
+      runner.init(testing_paths.testrun_dir .. "/luacov.config")
+
+      -- serve the synthetic repository below instead of the rocks servers
+      saved.get_versions = manif.get_versions
+      saved.search_repos = search.search_repos
+      saved.load_rockspec = fetch.load_rockspec
+      manif.get_versions = function()
+         return {}, {}
+      end
+      search.search_repos = function(query)
+         local versions = {}
+         for version in pairs(repo[query.name] or {}) do
+            versions[version] = { { arch = "rockspec", repo = "http://example.com" } }
+         end
+         return { [query.name] = versions }
+      end
+      fetch.load_rockspec = function(url)
+         local name, version = url:match("([^/]+)%-([^-]+%-%d+)%.rockspec$")
+         local list = {}
+         for _, dep in ipairs(repo[name][version]) do
+            table.insert(list, queries.from_dep_string(dep))
+         end
+         return { dependencies = { queries = list } }
+      end
+   end)
+
+   lazy_teardown(function()
+      manif.get_versions = saved.get_versions
+      search.search_repos = saved.search_repos
+      fetch.load_rockspec = saved.load_rockspec
+      runner.save_stats()
+   end)
+
+   local function versions_of(plan)
+      local selected = {}
+      for _, step in ipairs(plan) do
+         selected[step.name] = step.version
+      end
+      return selected
+   end
+
+   it("backtracks to a version compatible with all dependents", function()
+      repo = {
+         c = { ["1.0-1"] = {}, ["2.0-1"] = {} },
+         x = { ["1.0-1"] = { "c >= 2.0" } },
+         y = { ["1.0-1"] = { "c >= 1.0" }, ["2.0-1"] = { "c < 2.0" } },
+      }
+      local plan = assert(solver.solve({ queries.new("y"), queries.new("x") }, "one", {}))
+      assert.same({ c = "2.0-1", x = "1.0-1", y = "1.0-1" }, versions_of(plan))
+      assert.same("c", plan[1].name)
+   end)
+
+   it("explains conflicts", function()
+      repo = {
+         x = { ["1.0-1"] = { "z >= 3" } },
+         z = { ["1.0-1"] = {} },
+      }
+      local plan, err, conflict = solver.solve({ queries.new("x") }, "one", {}, "foo", "1.0-1")
+      assert.is_nil(plan)
+      assert.same("z", conflict)
+      assert.matches("z >= 3 (required by x 1.0-1)", err, 1, true)
+      assert.matches("Available versions: 1.0-1", err, 1, true)
+   end)
+
+   it("resolves large synthetic dependency graphs", function()
+      -- each version k of p<i> depends on p<i+1> >= k, and p<n> only
+      -- exists up to version 2, so most choices have to be revised
+      local n = 300
+      repo = {}
+      for i = 1, n do
+         repo["p" .. i] = {}
+         local top = (i == n) and 2 or 5
+         for k = 1, top do
+            repo["p" .. i][k .. ".0-1"] = (i < n) and { "p" .. (i + 1) .. " >= " .. k } or {}
+         end
+      end
+      local plan = assert(solver.solve({ queries.new("p1") }, "one", {}))
+      assert.same(n, #plan)
+      assert.same("p" .. n, plan[1].name)
+      assert.same("2.0-1", versions_of(plan)["p1"])
+   end)
+end)
@@ -42,6 +42,21 @@ describe("luarocks.util #unit", function()
       end)
    end)
 
+   describe("util.jobs_count", function()
+      it("accepts positive integers", function()
+         assert.same(1, util.jobs_count("1"))
+         assert.same(8, util.jobs_count("8"))
+      end)
+
+      it("rejects zero, negative, fractional and non-numeric values", function()
+         for _, s in ipairs({ "0", "-2", "1.5", "abc" }) do
+            local n, err = util.jobs_count(s)
+            assert.is_nil(n)
+            assert.match("positive integer", err)
+         end
+      end)
+   end)
+
    describe("util.sortedpairs", function()
       local function collect(iter, state, var)
          local collected = {}
@@ -0,0 +1,71 @@
+#!/usr/bin/env lua
+
+--- A minimal HTTP server for testing conditional downloads.
+-- Files of the fixtures directory are served at /<name> with an ETag and
+-- a Last-Modified date which changes on every response, as some CDNs do.
+-- The number of body bytes sent so far is served at /bytes, and the
+-- number of requests for files which do not exist at /misses.
+local socket = require("socket")
+
+local basedir = arg[1] or "./spec/fixtures"
+local server = assert(socket.bind("localhost", 8081))
+local sent = 0
+local misses = 0
+
+local function etag_of(data)
+   local sum = 0
+   for i = 1, #data do
+      sum = (sum * 31 + data:byte(i)) % 4294967296
+   end
+   return string.format("\"%d-%08x\"", #data, sum)
+end
+
+local function respond(client, status, headers, body)
+   local lines = { "HTTP/1.1 " .. status, "Connection: close", "Content-Length: " .. #(body or "") }
+   for name, value in pairs(headers) do
+      table.insert(lines, name .. ": " .. value)
+   end
+   client:send(table.concat(lines, "\r\n") .. "\r\n\r\n" .. (body or ""))
+end
+
+while true do
+   local client = server:accept()
+   client:settimeout(5)
+   local request = client:receive("*l") or ""
+   local path = request:match("^%u+ (/%S*)")
+   local headers = {}
+   repeat
+      local line = client:receive("*l")
+      local name, value = (line or ""):match("^([^:]+):%s*(.-)%s*$")
+      if name then
+         headers[name:lower()] = value
+      end
+   until not line or line == ""
+
+   if path == "/shutdown" then
+      respond(client, "200 OK", {})
+      client:close()
+      os.exit()
+   elseif path == "/bytes" then
+      respond(client, "200 OK", {}, tostring(sent))
+   elseif path == "/misses" then
+      respond(client, "200 OK", {}, tostring(misses))
+   else
+      local fd = path and io.open(basedir .. path, "rb")
+      if not fd then
+         respond(client, "404 Not Found", {})
+         misses = misses + 1
+      else
+         local data = fd:read("*a")
+         fd:close()
+         local etag = etag_of(data)
+         if headers["if-none-match"] == etag then
+            respond(client, "304 Not Modified", { ETag = etag })
+         else
+            respond(client, "200 OK", { ETag = etag, ["Last-Modified"] = os.date("!%a, %d %b %Y %H:%M:%S GMT") }, data)
+            sent = sent + #data
+         end
+      end
+   end
+   client:close()
+end
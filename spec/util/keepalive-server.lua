@@ -0,0 +1,79 @@
+#!/usr/bin/env lua
+
+--- A minimal HTTP/1.1 server for testing connection reuse.
+-- Files of the fixtures directory are served at /<name>, keeping the
+-- connection open after each response. The number of connections
+-- accepted so far is served at /connections. A request to /drop-idle is
+-- answered as if the connection was kept open, but all connections are
+-- then closed, as servers do with connections left idle for too long.
+local socket = require("socket")
+local unpack = table.unpack or unpack
+
+local basedir = arg[1] or "./spec/fixtures"
+local server = assert(socket.bind("localhost", 8082))
+local clients = {}
+local accepted = 0
+
+local function respond(client, status, body)
+   local lines = { "HTTP/1.1 " .. status, "Content-Length: " .. #(body or "") }
+   client:send(table.concat(lines, "\r\n") .. "\r\n\r\n" .. (body or ""))
+end
+
+local function drop(client)
+   client:close()
+   for i, c in ipairs(clients) do
+      if c == client then
+         table.remove(clients, i)
+         break
+      end
+   end
+end
+
+local function serve(client)
+   local request = client:receive("*l")
+   if not request then
+      drop(client)
+      return
+   end
+   local path = request:match("^%u+ (/%S*)")
+   repeat
+      local line = client:receive("*l")
+   until not line or line == ""
+
+   if path == "/shutdown" then
+      respond(client, "200 OK")
+      os.exit()
+   elseif path == "/connections" then
+      respond(client, "200 OK", tostring(accepted))
+   elseif path == "/drop-idle" then
+      respond(client, "200 OK")
+      for i = #clients, 1, -1 do
+         drop(clients[i])
+      end
+   else
+      local fd = path and io.open(basedir .. path, "rb")
+      if not fd then
+         respond(client, "404 Not Found")
+      else
+         local data = fd:read("*a")
+         fd:close()
+         respond(client, "200 OK", data)
+      end
+   end
+end
+
+while true do
+   local readable = socket.select({ server, unpack(clients) })
+   for _, s in ipairs(readable) do
+      if s == server then
+         local client = server:accept()
+         if client then
+            client:settimeout(5)
+            accepted = accepted + 1
+            table.insert(clients, client)
+         end
+      else
+         serve(s)
+      end
+   end
+end
@@ -1005,23 +1005,18 @@ local function setup_luarocks()
    print("LuaRocks set up correctly!")
 end
 
-local function mock_api_call(path)
-   return test_env.execute(C(tool("wget"), "--timeout=0.1 --quiet --tries=10 http://localhost:8080" .. path))
+local function mock_api_call(path, port)
+   return test_env.execute(C(tool("wget"), "--timeout=0.1 --quiet --tries=10 http://localhost:" .. (port or 8080) .. path))
 end
 
-function test_env.mock_server_init()
-   if not test_env.mock_prepared then
-      error("need to setup_specs with with_mock set to true")
-   end
-
+local function start_server(script, ping_path, port, basedir)
    local testing_paths = test_env.testing_paths
-   assert(test_env.need_rock("restserver-xavante"))
 
    local lua = Q(testing_paths.lua)
-   local mock_server = Q(dir_path(testing_paths.util_dir, "mock-server.lua"))
-   local fixtures_dir = Q(testing_paths.fixtures_dir)
+   local server = Q(dir_path(testing_paths.util_dir, script))
+   local served_dir = Q(basedir or testing_paths.fixtures_dir)
 
-   local cmd = C(lua, mock_server, fixtures_dir)
+   local cmd = C(lua, server, served_dir)
 
    local bg_cmd = test_env.TEST_TARGET_OS == "windows"
                   and C("start", "/b", "\"\"", cmd)
@@ -1030,20 +1025,55 @@ function test_env.mock_server_init()
    os.execute(test_env.execute_helper(bg_cmd, true, test_env.env_variables))
 
    for _ = 1, 100 do
-      if mock_api_call("/api/tool_version") then
+      if mock_api_call(ping_path, port) then
          break
       end
       os.execute(test_env.TEST_TARGET_OS == "windows"
                  and "ping 192.0.2.0 -n 1 -w 250 > NUL"
                  or  "sleep 0.1")
    end
+end
+
+function test_env.mock_server_init()
+   if not test_env.mock_prepared then
+      error("need to setup_specs with with_mock set to true")
+   end
 
+   assert(test_env.need_rock("restserver-xavante"))
+
+   start_server("mock-server.lua", "/api/tool_version")
 end
 
 function test_env.mock_server_done()
    mock_api_call("/shutdown")
 end
 
+--- Start a server answering conditional requests on port 8081,
+-- see spec/util/conditional-server.lua.
+-- @param basedir string or nil: the directory to serve, by default the
+-- fixtures directory.
+function test_env.conditional_server_init(basedir)
+   assert(test_env.need_rock("luasocket"))
+
+   start_server("conditional-server.lua", "/bytes", 8081, basedir)
+end
+
+function test_env.conditional_server_done()
+   mock_api_call("/shutdown", 8081)
+end
+
+--- Start a server keeping connections open on port 8082,
+-- see spec/util/keepalive-server.lua.
+function test_env.keepalive_server_init()
+   assert(test_env.need_rock("luasocket"))
+
+   start_server("keepalive-server.lua", "/connections", 8082)
+end
+
+function test_env.keepalive_server_done()
+   mock_api_call("/shutdown", 8082)
+end
+
 local function find_binary_rock(src_rock, dirname)
    local patt = src_rock:gsub("([.-])", "%%%1"):gsub("src", ".*[^s][^r][^c]")
    for name in lfs.dir(dirname) do
@@ -1,4 +1,4 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local string = _tl_compat and _tl_compat.string or string
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local math = _tl_compat and _tl_compat.math or math; local string = _tl_compat and _tl_compat.string or string
 
 
 local make_manifest = {}
@@ -24,6 +24,15 @@ function make_manifest.add_to_parser(parser)
 
    cmd:flag("--local-tree", "If given, do not write versioned versions of the manifest file.\n" ..
    "Use this when rebuilding the manifest of a local rocks tree.")
+   cmd:flag("--shards", "Also write the manifest of each Lua version split in one " ..
+   "file per package, so that clients can fetch only the packages they need.\n" ..
+   "Shards are always updated if the repository already has them.")
+   cmd:option("--deltas", "Keep the <n> previous revisions of each versioned manifest, " ..
+   "and publish deltas from them to the current one, so that clients can " ..
+   "update their cached copy without downloading the whole manifest.\n" ..
+   "Deltas are always updated if the repository already has them."):
+   argname("<n>"):
+   convert(tonumber)
    util.deps_mode_option(cmd)
 end
 
@@ -39,7 +48,7 @@ function make_manifest.command(args)
       util.warning("This looks like a local rocks tree, but you did not pass --local-tree.")
    end
 
-   local ok, err = writer.make_manifest(repo, deps.get_deps_mode(args), not args.local_tree)
+   local ok, err = writer.make_manifest(repo, deps.get_deps_mode(args), not args.local_tree, args.shards or nil, args.deltas and math.floor(args.deltas))
    if ok and not args.local_tree then
       util.printout("Generating index.html for " .. repo)
       index.make_index(repo)
@@ -141,7 +141,7 @@ local function process_dependencies(rockspec, opts, cwd)
             path.use_tree(cfg.root_dir)
          end
 
-         local _ok, err, errcode = deps.fulfill_dependencies(rockspec, "build_dependencies", "all", opts.verify, deplock_dir)
+         local _ok, err, errcode = deps.fulfill_dependencies(rockspec, "build_dependencies", "all", opts.verify, deplock_dir, opts.frozen)
 
          path.add_to_package_paths(cfg.root_dir)
 
@@ -160,7 +160,7 @@ local function process_dependencies(rockspec, opts, cwd)
       end
    end
 
-   return deps.fulfill_dependencies(rockspec, "dependencies", opts.deps_mode, opts.verify, deplock_dir)
+   return deps.fulfill_dependencies(rockspec, "dependencies", opts.deps_mode, opts.verify, deplock_dir, opts.frozen)
 end
 
 local function fetch_and_change_to_source_dir(rockspec, opts)
@@ -398,6 +398,9 @@ function build.build_rockspec(rockspec, opts, cwd)
    if not ok then return nil, err end
 
    if opts.pin then
+      if opts.frozen then
+         return nil, "--pin and --frozen cannot be used together"
+      end
       deplocks.init(rockspec.name, ".")
    end
 
@@ -1,4 +1,4 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local os = _tl_compat and _tl_compat.os or os; local package = _tl_compat and _tl_compat.package or package; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local _tl_table_unpack = unpack or table.unpack; local type = type
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local package = _tl_compat and _tl_compat.package or package; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local _tl_table_unpack = unpack or table.unpack; local type = type
 
 local builtin = {}
 
@@ -23,6 +23,7 @@ local util = require("luarocks.util")
 local cfg = require("luarocks.core.cfg")
 local dir = require("luarocks.dir")
 local deps = require("luarocks.deps")
+local object_cache = require("luarocks.tools.object_cache")
 
 local function autoextract_libs(external_dependencies, variables)
    if not external_dependencies then
@@ -131,8 +132,125 @@ end
 
 
 
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+local function object_done(links, job)
+   local l = links[job.module]
+   l.pending = l.pending - 1
+   if l.pending == 0 then
+      return l.link()
+   end
+   return true
+end
+
+
+
+
+
+
+
+
+
+
+
+
+
+local function fetch_cached(compile_jobs, links, jobs, cache, preprocess_command)
+   local commands = {}
+   for i, job in ipairs(compile_jobs) do
+      commands[i] = fs.quote_args(_tl_table_unpack(preprocess_command(job.object .. ".i", job.source, job.defines, job.incdirs)))
+   end
+   fs.execute_parallel(commands, jobs, function(i, ok)
+      local job = compile_jobs[i]
+      local preprocessed = job.object .. ".i"
+      if ok then
+         job.key = object_cache.key(preprocessed, table.concat(job.command, " "))
+      end
+      os.remove(preprocessed)
+      return true
+   end)
+
+   local remaining = {}
+   for _, job in ipairs(compile_jobs) do
+      if job.key and object_cache.fetch(cache, job.key, job.object) then
+         io.stdout:write(table.concat(job.command, " ") .. " (cached)\n")
+         local ok, err = object_done(links, job)
+         if not ok then
+            return nil, err
+         end
+      else
+         table.insert(remaining, job)
+      end
+   end
+   return remaining
+end
+
+
+
+
+
+
+
+
+
+
+
+local function compile_parallel(compile_jobs, links, jobs, cache)
+   local commands = {}
+   for i, job in ipairs(compile_jobs) do
+      commands[i] = fs.quote_args(_tl_table_unpack(job.command))
+   end
+   local err
+   fs.execute_parallel(commands, jobs, function(i, ok, output)
+      local job = compile_jobs[i]
+      io.stdout:write(table.concat(job.command, " ") .. "\n")
+      io.stdout:write(output)
+      if err then
+
+         return false
+      end
+      if not ok then
+         err = "Failed compiling object " .. job.object
+         return false
+      end
+      if job.key then
+         object_cache.store(cache, job.key, job.object)
+      end
+      local lok, lerr = object_done(links, job)
+      if not lok then
+         err = lerr
+         return false
+      end
+      return true
+   end)
+   if err then
+      return nil, err
+   end
+   return true
+end
+
+
+
+
+
 function builtin.run(rockspec, no_install)
-   local compile_object
+   local object_command
+   local preprocess_command
    local compile_library
 
 
@@ -157,11 +275,17 @@ function builtin.run(rockspec, no_install)
    end
 
    if cfg.is_platform("mingw32") then
-      compile_object = function(object, source, defines, incdirs)
+      object_command = function(object, source, defines, incdirs)
          local extras = {}
          add_flags(extras, "-D%s", defines)
          add_flags(extras, "-I%s", incdirs)
-         return execute(variables.CC .. " " .. variables.CFLAGS, "-c", "-o", object, "-I" .. variables.LUA_INCDIR, source, _tl_table_unpack(extras))
+         return { variables.CC .. " " .. variables.CFLAGS, "-c", "-o", object, "-I" .. variables.LUA_INCDIR, source, _tl_table_unpack(extras) }
+      end
+      preprocess_command = function(file, source, defines, incdirs)
+         local extras = {}
+         add_flags(extras, "-D%s", defines)
+         add_flags(extras, "-I%s", incdirs)
+         return { variables.CC .. " " .. variables.CFLAGS, "-E", "-o", file, "-I" .. variables.LUA_INCDIR, source, _tl_table_unpack(extras) }
       end
       compile_library = function(library, objects, libraries, libdirs, name)
          local extras = { _tl_table_unpack(objects) }
@@ -190,11 +314,17 @@ function builtin.run(rockspec, no_install)
 
 
    elseif cfg.is_platform("win32") then
-      compile_object = function(object, source, defines, incdirs)
+      object_command = function(object, source, defines, incdirs)
          local extras = {}
          add_flags(extras, "-D%s", defines)
          add_flags(extras, "-I%s", incdirs)
-         return execute(variables.CC .. " " .. variables.CFLAGS, "-c", "-Fo" .. object, "-I" .. variables.LUA_INCDIR, source, _tl_table_unpack(extras))
+         return { variables.CC .. " " .. variables.CFLAGS, "-c", "-Fo" .. object, "-I" .. variables.LUA_INCDIR, source, _tl_table_unpack(extras) }
+      end
+      preprocess_command = function(file, source, defines, incdirs)
+         local extras = {}
+         add_flags(extras, "-D%s", defines)
+         add_flags(extras, "-I%s", incdirs)
+         return { variables.CC .. " " .. variables.CFLAGS, "-EP", "-P", "-Fi" .. file, "-I" .. variables.LUA_INCDIR, source, _tl_table_unpack(extras) }
       end
       compile_library = function(library, objects, libraries, libdirs, name)
          local extras = { _tl_table_unpack(objects) }
@@ -228,11 +358,17 @@ function builtin.run(rockspec, no_install)
 
 
    else
-      compile_object = function(object, source, defines, incdirs)
+      object_command = function(object, source, defines, incdirs)
+         local extras = {}
+         add_flags(extras, "-D%s", defines)
+         add_flags(extras, "-I%s", incdirs)
+         return { variables.CC .. " " .. variables.CFLAGS, "-I" .. variables.LUA_INCDIR, "-c", source, "-o", object, _tl_table_unpack(extras) }
+      end
+      preprocess_command = function(file, source, defines, incdirs)
          local extras = {}
          add_flags(extras, "-D%s", defines)
          add_flags(extras, "-I%s", incdirs)
-         return execute(variables.CC .. " " .. variables.CFLAGS, "-I" .. variables.LUA_INCDIR, "-c", source, "-o", object, _tl_table_unpack(extras))
+         return { variables.CC .. " " .. variables.CFLAGS, "-I" .. variables.LUA_INCDIR, "-E", source, "-o", file, _tl_table_unpack(extras) }
       end
       compile_library = function(library, objects, libraries, libdirs)
          local extras = { _tl_table_unpack(objects) }
@@ -279,6 +415,23 @@ function builtin.run(rockspec, no_install)
 
    local compile_temp_dir
 
+
+
+
+   local jobs = math.max(1, math.floor(cfg.build_jobs or 1))
+   local compile_jobs = {}
+   local links = {}
+
+
+
+   local cache
+   if cfg.object_cache_dir then
+      cache, err = object_cache.open(cfg.object_cache_dir)
+      if not cache then
+         util.warning(err)
+      end
+   end
+
    local mkdir_cache = {}
    local function cached_make_dir(name)
       if name == "" or mkdir_cache[name] then
@@ -322,6 +475,7 @@ function builtin.run(rockspec, no_install)
             checked_lua_h = true
          end
          local objects = {}
+         local queued = 0
          local sources = info.sources
          if info[1] then sources = info end
          if type(sources) == "string" then sources = { sources } end
@@ -336,9 +490,16 @@ function builtin.run(rockspec, no_install)
             if not object then
                object = source .. "." .. cfg.obj_extension
             end
-            ok = compile_object(object, source, info.defines, info.incdirs or autoincdirs)
-            if not ok then
-               return nil, "Failed compiling object " .. object
+            local incdirs = info.incdirs or autoincdirs
+            local command = object_command(object, source, info.defines, incdirs)
+            if cache or jobs > 1 then
+               table.insert(compile_jobs, { command = command, object = object, module = name, source = source, defines = info.defines, incdirs = incdirs })
+               queued = queued + 1
+            else
+               ok = execute(_tl_table_unpack(command))
+               if not ok then
+                  return nil, "Failed compiling object " .. object
+               end
             end
             table.insert(objects, object)
          end
@@ -358,15 +519,26 @@ function builtin.run(rockspec, no_install)
          cached_make_dir(build_dir)
 
          lib_modules[build_name] = dir.path(libdir, module_name)
-         ok = compile_library(build_name, objects, info.libraries, info.libdirs or autolibdirs, name)
-         if not ok then
-            return nil, "Failed compiling module " .. module_name
-         end
+         local mod = info
+         local function link()
+            if not compile_library(build_name, objects, mod.libraries, mod.libdirs or autolibdirs, name) then
+               return nil, "Failed compiling module " .. module_name
+            end
 
 
 
-         if cached_make_dir(dir.dir_name(module_name)) then
-            fs.copy(build_name, module_name)
+            if cached_make_dir(dir.dir_name(module_name)) then
+               fs.copy(build_name, module_name)
+            end
+            return true
+         end
+         if queued > 0 then
+            links[name] = { pending = queued, link = link }
+         else
+            ok, err = link()
+            if not ok then
+               return nil, err
+            end
          end
 
 
@@ -382,6 +554,21 @@ function builtin.run(rockspec, no_install)
 
       end
    end
+   if cache and #compile_jobs > 0 then
+      compile_jobs, err = fetch_cached(compile_jobs, links, jobs, cache, preprocess_command)
+      if not compile_jobs then
+         return nil, err
+      end
+   end
+   if #compile_jobs > 0 then
+      ok, err = compile_parallel(compile_jobs, links, jobs, cache)
+      if not ok then
+         return nil, err
+      end
+   end
+   if cache then
+      object_cache.close(cache, cfg.object_cache_size or 512)
+   end
    if not no_install then
       for _, mods in ipairs({ { tbl = lua_modules, perms = "read" }, { tbl = lib_modules, perms = "exec" } }) do
          for name, dest in pairs(mods.tbl) do
@@ -1,4 +1,4 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local assert = _tl_compat and _tl_compat.assert or assert; local io = _tl_compat and _tl_compat.io or io; local os = _tl_compat and _tl_compat.os or os; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local type = type
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local assert = _tl_compat and _tl_compat.assert or assert; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
 
 
 
@@ -16,12 +16,73 @@ local cmake = { CMakeBuild = {} }
 local fs = require("luarocks.fs")
 local util = require("luarocks.util")
 local cfg = require("luarocks.core.cfg")
+local dir = require("luarocks.dir")
 
 
 
 
 
 
+local function configure_cache_file(rockspec)
+   if not (cfg.cmake_configure_cache and cfg.local_cache) then
+      return nil
+   end
+   return dir.path(cfg.local_cache, "cmake", rockspec.name .. "-" .. rockspec.version .. ".cmake")
+end
+
+
+
+local function is_configure_cache_valid(cache_file, key)
+   local fd = io.open(cache_file, "r")
+   if not fd then
+      return false
+   end
+   local line = fd:read("*l")
+   fd:close()
+   return line == key
+end
+
+
+
+
+
+
+local function is_feature_check(name)
+   return name:match("^HAVE_") ~= nil or
+   name:match("^CMAKE_HAVE_") ~= nil or
+   name:match("^SIZEOF_") ~= nil or
+   name:match("_EXITCODE$") ~= nil
+end
+
+
+
+
+
+local function save_configure_cache(cache_file, key)
+   local source_dir = fs.current_dir()
+   local fd = io.open(dir.path(source_dir, "build.luarocks", "CMakeCache.txt"), "r")
+   if not fd then
+      return
+   end
+   local entries = { key }
+   for line in fd:lines() do
+      local name, value = line:match("^([%w_]+):INTERNAL=(.-)\r?$")
+      if name and is_feature_check(name) and not value:find(source_dir, 1, true) then
+         table.insert(entries, "set(" .. name .. " [==[" .. value .. "]==] CACHE INTERNAL \"\")")
+      end
+   end
+   fd:close()
+   fs.make_dir(dir.dir_name(cache_file))
+   local out = io.open(cache_file, "w")
+   if out then
+      out:write(table.concat(entries, "\n"), "\n")
+      out:close()
+   end
+end
+
+
+
+
 
 function cmake.run(rockspec, no_install)
    local build = rockspec.build
@@ -52,12 +113,41 @@ function cmake.run(rockspec, no_install)
       args = args .. " -DCMAKE_GENERATOR_PLATFORM=x64"
    end
 
-   for k, v in pairs(variables) do
+   for k, v in util.sortedpairs(variables) do
       args = args .. ' -D' .. k .. '="' .. tostring(v) .. '"'
    end
 
-   if not fs.execute_string(rockspec.variables.CMAKE .. " -H. -Bbuild.luarocks " .. args) then
-      return nil, "Failed cmake."
+   local cmd = rockspec.variables.CMAKE .. " -H. -Bbuild.luarocks " .. args
+
+
+
+   local cache_file = configure_cache_file(rockspec)
+   local key
+   local configured = false
+   if cache_file then
+      local toolchain = {}
+      for _, var in ipairs({ "CMAKE", "CC", "CFLAGS", "LD", "LDFLAGS", "LUA_INCDIR" }) do
+         table.insert(toolchain, var .. "=" .. tostring(rockspec.variables[var]))
+      end
+      key = ("# " .. cfg.arch .. " " .. table.concat(toolchain, " ") .. " " .. args):gsub("[\r\n]", " ")
+      if is_configure_cache_valid(cache_file, key) then
+         util.printout("Using cached configure results from " .. cache_file)
+         configured = fs.execute_string(cmd .. " -C" .. fs.Q(cache_file))
+         if not configured then
+            util.warning("Configuring with cached results failed, configuring again from scratch")
+            os.remove(cache_file)
+            fs.delete(dir.path(fs.current_dir(), "build.luarocks"))
+         end
+      end
+   end
+
+   if not configured then
+      if not fs.execute_string(cmd) then
+         return nil, "Failed cmake."
+      end
+      if cache_file then
+         save_configure_cache(cache_file, key)
+      end
    end
 
    local do_build, do_install
@@ -69,13 +159,16 @@ function cmake.run(rockspec, no_install)
       do_install = true
    end
 
+   local jobs = math.max(1, math.floor(cfg.build_jobs or 1))
+   local parallel = jobs > 1 and " --parallel " .. jobs or ""
+
    if do_build then
-      if not fs.execute_string(rockspec.variables.CMAKE .. " --build build.luarocks --config Release") then
+      if not fs.execute_string(rockspec.variables.CMAKE .. " --build build.luarocks --config Release" .. parallel) then
          return nil, "Failed building."
       end
    end
    if do_install and not no_install then
-      if not fs.execute_string(rockspec.variables.CMAKE .. " --build build.luarocks --target install --config Release") then
+      if not fs.execute_string(rockspec.variables.CMAKE .. " --build build.luarocks --target install --config Release" .. parallel) then
          return nil, "Failed installing."
       end
    end
@@ -0,0 +1,279 @@
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local table = _tl_compat and _tl_compat.table or table; local _tl_table_unpack = unpack or table.unpack
+
+
+
+
+
+
+
+local bundle = {}
+
+
+local fs = require("luarocks.fs")
+local dir = require("luarocks.dir")
+local path = require("luarocks.path")
+local util = require("luarocks.util")
+local fetch = require("luarocks.fetch")
+local search = require("luarocks.search")
+local queries = require("luarocks.queries")
+local deplocks = require("luarocks.deplocks")
+local solver = require("luarocks.deps.solver")
+
+
+
+
+
+
+
+
+
+
+
+
+local function add_item(items, seen, url, sha256)
+   if not seen[url] then
+      seen[url] = true
+      table.insert(items, { url = url, sha256 = sha256 })
+   end
+end
+
+
+
+local function find_url(name, namespace, version)
+   local url, err = search.find_suitable_rock(queries.new(name, namespace, version))
+   if not url then
+      return nil, "Could not find " .. name .. " " .. version .. " in the rocks servers: " .. err
+   end
+   return url
+end
+
+
+local function rockspec_items(rockspec_file)
+   local rockspec, err = fetch.load_rockspec(rockspec_file)
+   if not rockspec then
+      return nil, err
+   end
+
+   local items = {}
+   local seen = {}
+   local depskeys = { "build_dependencies", "dependencies" }
+   for _, depskey in ipairs(depskeys) do
+      local dependencies = (rockspec)[depskey].queries
+      local plan, plan_err = solver.solve(dependencies, "one", rockspec.rocks_provided, rockspec.name, rockspec.version)
+      if not plan then
+         return nil, "Could not satisfy dependencies of " .. rockspec.name .. " " .. rockspec.version .. ": " .. plan_err
+      end
+      for _, step in ipairs(plan) do
+         if not step.provided then
+
+            local url = step.url
+            if not url then
+               url, err = find_url(step.name, step.namespace, step.version)
+               if not url then
+                  return nil, err
+               end
+            end
+            add_item(items, seen, url)
+         end
+      end
+   end
+   return items
+end
+
+
+
+local function lockfile_items(lockfile)
+   if dir.base_name(lockfile) ~= "luarocks.lock" then
+      return nil, "Expected a rockspec or a luarocks.lock file, got " .. lockfile
+   end
+   local ok, filename, err = deplocks.load("", dir.dir_name(lockfile))
+   if not ok then
+      return nil, err
+   elseif not filename then
+      return nil, "Could not open lockfile " .. lockfile
+   end
+
+   local items = {}
+   local seen = {}
+   local depskeys = { "build_dependencies", "dependencies", "test_dependencies" }
+   for _, depskey in ipairs(depskeys) do
+      for dnsname, dversion in deplocks.each(depskey) do
+         local url, sha256 = deplocks.get_artifact(dnsname, dversion)
+         if not url then
+            local dname, dnamespace = util.split_namespace(dnsname)
+            url, err = find_url(dname, dnamespace, dversion)
+            if not url then
+               return nil, err
+            end
+         end
+         add_item(items, seen, url, sha256)
+      end
+   end
+   return items
+end
+
+
+
+
+local function check_names(items)
+   local urls = {}
+   for _, item in ipairs(items) do
+      local names = { dir.base_name(item.url) }
+      if item.url:match("%.rockspec$") then
+         local name, version = path.parse_name(item.url)
+         if name then
+            table.insert(names, name .. "-" .. version .. ".src.rock")
+         end
+      end
+      for _, name in ipairs(names) do
+         local other = urls[name]
+         if other and other ~= item.url then
+            return nil, "Cannot bundle both " .. other .. " and " .. item.url .. ": they would have the same file name, " .. name
+         end
+         urls[name] = item.url
+      end
+   end
+   return true
+end
+
+
+
+
+
+local function gather(items, target)
+   local pack = require("luarocks.pack")
+
+   local ok, err = check_names(items)
+   if not ok then
+      return nil, err
+   end
+
+   local urls = {}
+   for i, item in ipairs(items) do
+      urls[i] = item.url
+   end
+   fetch.prefetch(urls)
+
+   local pinned = {}
+   for _, item in ipairs(items) do
+      local file, err = fetch.fetch_url_at_temp_dir(item.url, "luarocks-bundle", nil, true)
+      if not file then
+         return nil, "Failed fetching " .. item.url .. ": " .. err
+      end
+      item.file = file
+      if item.sha256 then
+         table.insert(pinned, file)
+      end
+   end
+   if #pinned > 0 then
+      local sums, err = fs.get_checksums(pinned, "sha256")
+      if not sums then
+         return nil, err
+      end
+      for _, item in ipairs(items) do
+         if item.sha256 and sums[item.file] ~= item.sha256 then
+            return nil, "Digest mismatch for " .. item.url .. ": expected sha256 " .. item.sha256 .. ", got " .. tostring(sums[item.file])
+         end
+      end
+   end
+
+   for _, item in ipairs(items) do
+      if item.url:match("%.rockspec$") then
+         util.printout("Packing " .. dir.base_name(item.url) .. " as a source rock")
+         ok, err = fs.change_dir(target)
+         if not ok then return nil, err end
+         local rock_file, perr = pack.pack_source_rock(item.file)
+         fs.pop_dir()
+         if not rock_file then
+            return nil, perr
+         end
+      end
+      ok, err = fs.copy(item.file, dir.path(target, dir.base_name(item.url)), "read")
+      if not ok then
+         return nil, "Failed copying " .. item.file .. ": " .. err
+      end
+   end
+   return true
+end
+
+
+
+
+
+
+
+
+
+
+function bundle.create(input, output)
+   local writer = require("luarocks.manif.writer")
+
+   local items, err
+   if input:match("%.rockspec$") then
+      items, err = rockspec_items(input)
+   else
+      items, err = lockfile_items(input)
+   end
+   if not items then
+      return nil, err
+   end
+
+   local temp_dir, errmake = fs.make_temp_dir("luarocks-bundle")
+   if not temp_dir then
+      return nil, "Failed creating temporary directory: " .. errmake
+   end
+   util.schedule_function(fs.delete, temp_dir)
+
+   local ok
+   ok, err = gather(items, temp_dir)
+   if not ok then
+      return nil, err
+   end
+   ok, err = writer.make_manifest(temp_dir, "one", true)
+   if not ok then
+      return nil, err
+   end
+
+   output = fs.absolute_name(output)
+   fs.delete(output)
+   ok, err = fs.change_dir(temp_dir)
+   if not ok then return nil, err end
+   ok, err = fs.zip(output, _tl_table_unpack(fs.list_dir()))
+   fs.pop_dir()
+   if not ok then
+      return nil, "Failed writing bundle " .. output .. ": " .. err
+   end
+   util.printout("Bundled " .. #items .. " rocks in " .. output)
+   return true
+end
+
+
+
+
+
+function bundle.unpack(file)
+   local filename = fs.absolute_name(file)
+   if not fs.exists(filename) then
+      return nil, "Bundle not found: " .. file
+   end
+   local temp_dir, err = fs.make_temp_dir("luarocks-bundle")
+   if not temp_dir then
+      return nil, "Failed creating temporary directory: " .. err
+   end
+   util.schedule_function(fs.delete, temp_dir)
+
+   local ok
+   ok, err = fs.change_dir(temp_dir)
+   if not ok then return nil, err end
+   ok, err = fs.unzip(filename)
+   fs.pop_dir()
+   if not ok then
+      return nil, "Failed unpacking bundle " .. file .. ": " .. err
+   end
+   if not fs.exists(dir.path(temp_dir, "manifest")) then
+      return nil, file .. " is not a bundle: it has no manifest"
+   end
+   return temp_dir
+end
+
+return bundle
@@ -181,6 +181,21 @@ local function process_server_args(args)
       cfg.rocks_servers = { args.only_server }
    end
 
+   if args.bundle_file then
+      if args.dev or args.server or args.only_server then
+         return nil, "--bundle cannot be used with --server, --only-server or --dev"
+      end
+      local bundle = require("luarocks.bundle")
+      local bundle_dir, err = bundle.unpack(args.bundle_file)
+      if not bundle_dir then
+         return nil, err
+      end
+      cfg.rocks_servers = { bundle_dir }
+
+      local deplocks = require("luarocks.deplocks")
+      deplocks.use_artifacts_from(bundle_dir)
+   end
+
    return true
 end
 
@@ -494,6 +509,11 @@ Enabling completion for Fish:
    "(overrides any entries in the config file)."):
    argname("<server>"):
    hidden_name("--only-from")
+   parser:option("--bundle", "Fetch rocks only from this bundle, as written " ..
+   "by `luarocks bundle`, without network access (overrides any entries " ..
+   "in the config file)."):
+   argname("<file>"):
+   target("bundle_file")
    parser:option("--only-sources", "Restrict downloads to paths matching the given URL."):
    argname("<url>"):
    hidden_name("--only-sources-from")
@@ -704,6 +724,10 @@ function cmd.run_command(description, commands, external_namespace, ...)
       cfg.project_dir = fs.absolute_name(cfg.project_dir)
    end
 
+   if args.jobs then
+      cfg.build_jobs = args.jobs
+   end
+
    if args.verbose then
       cfg.verbose = true
       print(("-"):rep(79))
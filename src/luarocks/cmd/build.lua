@@ -18,6 +18,7 @@ local build = require("luarocks.build")
 local search = require("luarocks.search")
 local make = require("luarocks.cmd.make")
 local repos = require("luarocks.repos")
+local rock_cache = require("luarocks.rock_cache")
 
 
 
@@ -56,6 +57,38 @@ end
 
 
 
+
+local function build_rockspec_cached(rockspec, opts, cwd)
+   local entry
+   if not (opts.no_install or opts.build_only_deps or opts.pin or opts.branch) then
+      entry = rock_cache.entry_dir(rockspec)
+   end
+   local cached = entry and rock_cache.find(entry)
+   if cached then
+      util.printout("Installing cached binary rock " .. cached)
+      local install = require("luarocks.cmd.install")
+      return install.install_binary_rock(cached, {
+         namespace = opts.namespace,
+         deps_mode = opts.deps_mode,
+         force = opts.rebuild,
+         verify = opts.verify,
+         frozen = opts.frozen,
+         no_doc = opts.no_doc,
+      })
+   end
+
+   local name, version = build.build_rockspec(rockspec, opts, cwd)
+   if name and entry then
+      rock_cache.store(entry, name, version, opts.namespace)
+   end
+   return name, version
+end
+
+
+
+
+
+
 local function build_rock(rock_filename, opts)
 
    local cwd = fs.absolute_name(dir.path("."))
@@ -79,7 +112,7 @@ local function build_rock(rock_filename, opts)
       return nil, err, errcode
    end
 
-   local n, v = build.build_rockspec(rockspec, opts, cwd)
+   local n, v = build_rockspec_cached(rockspec, opts, cwd)
 
    ok, err, errcode = n ~= nil, v, nil
 
@@ -114,7 +147,7 @@ local function do_build(name, namespace, version, opts)
       if not rockspec then
          return nil, err
       end
-      return build.build_rockspec(rockspec, opts, cwd)
+      return build_rockspec_cached(rockspec, opts, cwd)
    end
 
    if url:match("%.src%.rock$") then
@@ -150,7 +183,9 @@ function cmd_build.command(args)
       verify = not not args.verify,
       check_lua_versions = not not args.check_lua_versions,
       pin = not not args.pin,
+      frozen = not not args.frozen,
       rebuild = not not (args.force or args.force_fast),
+      no_doc = not not args.no_doc,
       no_install = false,
    }
 
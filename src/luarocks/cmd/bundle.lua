@@ -0,0 +1,48 @@
+
+
+
+local cmd_bundle = {}
+
+
+local util = require("luarocks.util")
+local dir = require("luarocks.dir")
+local bundle = require("luarocks.bundle")
+
+
+
+
+
+function cmd_bundle.add_to_parser(parser)
+   local cmd = parser:command("bundle", [[
+Resolve the dependencies of a rockspec, or take the ones pinned in a
+luarocks.lock file, and write the rocks they need, along with a manifest, to
+a single file. The bundle can then be used to install them without network
+access, with the
+
+   luarocks make
+
+Rocks which are only available are bundled rocks.
+The build dependencies of the bundled source rocks are not bundled.]], util.see_also())
+      :summary("Bundle dependencies for offline installation.")
+
+   cmd:argument("file", "A rockspec, or a luarocks.lock file.")
+   cmd:option("--output", "Write the bundle to this file. Default is " ..
+   "<name>-<version>.bundle.zip for a rockspec, and luarocks.bundle.zip " ..
+   "for a lockfile.")
+      :argname("<file>")
+end
+
+
+
+
+function cmd_bundle.command(args)
+   local output = args.output
+   if not output then
+      local base = dir.base_name(args.file)
+      output = base:match("^(.*)%.rockspec$") or "luarocks"
+      output = output .. ".bundle.zip"
+   end
+   return bundle.create(args.file, output)
+end
+
+return cmd_bundle
@@ -0,0 +1,102 @@
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local string = _tl_compat and _tl_compat.string or string
+
+local cache = {}
+
+
+local util = require("luarocks.util")
+local cfg = require("luarocks.core.cfg")
+local download_cache = require("luarocks.download_cache")
+local shared_store = require("luarocks.shared_store")
+
+
+
+
+
+function cache.add_to_parser(parser)
+   local cmd = parser:command("cache", [[
+Show statistics of the download cache, or maintain it.
+
+Rocks and rockspecs downloaded by LuaRocks are kept in the local cache
+directory, stored once under their SHA-256 digest whatever the server they
+were fetched from. When the cache grows larger than download_cache_size
+megabytes, the least recently used files are removed.
+
+When shared_store_dir is configured, the files deployed into rocks trees are
+also stored there once, and shared by the trees.
+
+* stats (the default) prints the number and total size of cached files.
+* prune removes the least recently used files until the cache fits in
+  download_cache_size megabytes, or in the size given with --max-size,
+  and removes files which are not listed in the cache index. It also
+  removes the files of the shared store which no tree uses anymore.
+  Files shared through reflinks cannot be told apart from unused ones, so
+  prune empties a store used with reflinks.
+* verify checks the digest of every cached file, removing corrupted ones.
+* clear removes all cached files.]], util.see_also())
+      :summary("Show or prune the download cache.")
+
+   cmd:argument("action", "stats, prune, verify or clear.")
+      :args("?")
+      :choices({"stats", "prune", "verify", "clear"})
+   cmd:option("--max-size", "With prune, the size in megabytes to reduce the cache to.")
+      :argname("<mb>")
+      :convert(tonumber)
+end
+
+local function megabytes(size)
+   return string.format("%.1f MB", size / (1024 * 1024))
+end
+
+
+
+
+function cache.command(args)
+   local action = args.action or "stats"
+   if (cfg.download_cache_size or 0) <= 0 and not (shared_store.enabled() and (action == "stats" or action == "prune")) then
+      return nil, "The download cache is disabled (download_cache_size is 0)."
+   end
+
+   if action == "prune" then
+      if (cfg.download_cache_size or 0) > 0 then
+         local max_size = args.max_size or cfg.download_cache_size
+         local removed, total = download_cache.prune(max_size * 1024 * 1024)
+         if not removed then
+            return nil, total
+         end
+         util.printout("Removed " .. removed .. " files, " .. megabytes(total) .. " left in the cache.")
+      end
+      if shared_store.enabled() then
+         util.printout("Removed " .. shared_store.prune() .. " unused files from the shared store.")
+      end
+   elseif action == "verify" then
+      local bad, err = download_cache.verify()
+      if not bad then
+         return nil, err
+      end
+      for _, digest in ipairs(bad) do
+         util.printout("Removed corrupted file " .. digest)
+      end
+      util.printout(#bad .. " corrupted files found.")
+   elseif action == "clear" then
+      local ok, err = download_cache.clear()
+      if not ok then
+         return nil, err
+      end
+      util.printout("Download cache cleared.")
+   else
+      if (cfg.download_cache_size or 0) > 0 then
+         local stats = download_cache.stats()
+         util.printout("Cache directory: " .. cfg.local_cache)
+         util.printout("Files:           " .. stats.files .. " (" .. megabytes(stats.size) .. " of " .. cfg.download_cache_size .. " MB)")
+         util.printout("Known URLs:      " .. stats.urls)
+      end
+      if shared_store.enabled() then
+         local stats = shared_store.stats()
+         util.printout("Shared store:    " .. cfg.shared_store_dir)
+         util.printout("Shared files:    " .. stats.files .. " (" .. megabytes(stats.size) .. ")")
+      end
+   end
+   return true
+end
+
+return cache
@@ -15,6 +15,7 @@ local repo_writer = require("luarocks.repo_writer")
 local remove = require("luarocks.remove")
 local search = require("luarocks.search")
 local queries = require("luarocks.queries")
+local solver = require("luarocks.deps.solver")
 local cfg = require("luarocks.core.cfg")
 
 
@@ -52,10 +53,20 @@ function install.add_to_parser(parser)
    "and report if it is available for another Lua version.")
    util.deps_mode_option(cmd)
    cmd:flag("--no-manifest", "Skip creating/updating the manifest")
+   cmd:flag("--dry-run", "Resolve the rock and all of its dependencies and " ..
+   "print the installation plan, without installing anything.")
    cmd:flag("--pin", "If the installed rock is a Lua module, create a " ..
    "luarocks.lock file listing the exact versions of each dependency found for " ..
    "this rock (recursively), and store it in the rock's directory. " ..
    "Ignores any existing luarocks.lock file in the rock's sources.")
+   cmd:flag("--frozen", "Install the dependencies from the rocks and " ..
+   "rockspecs pinned in the luarocks.lock file, checking their digests, " ..
+   "without searching the rocks servers. Fails if a dependency has no " ..
+   "pinned rock or rockspec, instead of resolving it.")
+   cmd:option("--jobs", "Number of compiler processes to run at the same " ..
+   "time when building C modules from rockspecs with the builtin build type.")
+      :argname("<n>")
+      :convert(util.jobs_count)
 
    parser:flag("--pack-binary-rock"):hidden(true)
    parser:option("--branch"):hidden(true)
@@ -118,7 +129,7 @@ function install.install_binary_rock(rock_file, opts)
       local deplock_dir = fs.exists(dir.path(".", "luarocks.lock")) and
       "." or
       install_dir
-      ok, err, errcode = deps.fulfill_dependencies(rockspec, "dependencies", deps_mode, opts.verify, deplock_dir)
+      ok, err, errcode = deps.fulfill_dependencies(rockspec, "dependencies", deps_mode, opts.verify, deplock_dir, opts.frozen)
       if not ok then return nil, err, errcode end
    end
 
@@ -155,23 +166,27 @@ function install.install_binary_rock_deps(rock_file, opts)
       return nil, "Incompatible architecture " .. arch, "arch"
    end
 
-   local install_dir = path.install_dir(name, version)
 
-   local oks, err, errcode = fetch.fetch_and_unpack_rock(rock_file, install_dir, opts.verify)
-   if not oks then return nil, err, errcode end
+
+   local rockspec_file = name .. "-" .. version .. ".rockspec"
+   local unpack_dir, err, errcode = fetch.fetch_and_unpack_rock(rock_file, nil, opts.verify, { rockspec_file, "luarocks.lock" })
+   if not unpack_dir then return nil, err, errcode end
+   if not fs.exists(dir.path(unpack_dir, rockspec_file)) then
+      return nil, "Rock " .. rock_file .. " does not contain its rockspec, " .. rockspec_file
+   end
 
    local rockspec
-   rockspec, err = fetch.load_rockspec(path.rockspec_file(name, version))
+   rockspec, err = fetch.load_rockspec(dir.path(unpack_dir, rockspec_file))
    if err then
       return nil, "Failed loading rockspec for installed package: " .. err, errcode
    end
 
    local deplock_dir = fs.exists(dir.path(".", "luarocks.lock")) and
    "." or
-   install_dir
+   unpack_dir
 
    local ok
-   ok, err, errcode = deps.fulfill_dependencies(rockspec, "dependencies", opts.deps_mode, opts.verify, deplock_dir)
+   ok, err, errcode = deps.fulfill_dependencies(rockspec, "dependencies", opts.deps_mode, opts.verify, deplock_dir, opts.frozen)
    if not ok then return nil, err, errcode end
 
    util.printout()
@@ -214,13 +229,39 @@ end
 
 
 
+local function print_install_plan(args)
+   local deps_mode = deps.get_deps_mode(args)
+   local plan, err
+   if args.rock:match("%.rockspec$") then
+      local rockspec, rerr = fetch.load_rockspec(args.rock)
+      if not rockspec then
+         return nil, rerr
+      end
+      plan, err = solver.solve(rockspec.dependencies.queries, deps_mode, rockspec.rocks_provided, rockspec.name, rockspec.version)
+   elseif args.rock:match("%.rock$") then
+      return nil, "--dry-run needs the name of a rock or a rockspec"
+   else
+      plan, err = solver.solve({ queries.new(args.rock, args.namespace, args.version) }, deps_mode, util.get_rocks_provided())
+   end
+   if not plan then
+      return nil, "Could not satisfy dependencies: " .. err
+   end
+   solver.print_plan(plan)
+   return true
+end
+
+
+
+
 
 
 
 
 
 function install.command(args)
-   if args.rock:match("%.rockspec$") or args.rock:match("%.src%.rock$") then
+   if args.dry_run then
+      return print_install_plan(args)
+   elseif args.rock:match("%.rockspec$") or args.rock:match("%.src%.rock$") then
       local build = require("luarocks.cmd.build")
       return build.command(args)
    elseif args.rock:match("%.rock$") then
@@ -233,6 +274,7 @@ function install.command(args)
          no_doc = not not args.no_doc,
          deps_mode = deps_mode,
          verify = not not args.verify,
+         frozen = not not args.frozen,
       }
       if args.only_deps then
          return install_rock_file_deps(args.rock, opts)
@@ -253,7 +295,7 @@ function install.command(args)
 end
 
 install.needs_lock = function(args)
-   if args.pack_binary_rock then
+   if args.pack_binary_rock or args.dry_run then
       return false
    end
    return true
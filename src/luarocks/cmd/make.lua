@@ -26,6 +26,11 @@ local fs = require("luarocks.fs")
 function make.cmd_options(parser)
    parser:flag("--no-install", "Do not install the rock.")
    parser:flag("--no-doc", "Install the rock without its documentation.")
+   parser:option("--jobs", "Number of compiler processes to run at the same " ..
+   "time when building C modules with the builtin build type. Default is " ..
+   tostring(cfg.build_jobs) .. ".")
+      :argname("<n>")
+      :convert(util.jobs_count)
    parser:flag("--pack-binary-rock", "Do not install rock. Instead, produce a " ..
    ".rock file with the contents of compilation in the current directory.")
    parser:flag("--keep", "Do not remove previously installed versions of the " ..
@@ -48,6 +53,10 @@ function make.cmd_options(parser)
    "and report if it is available for another Lua version.")
    parser:flag("--pin", "Pin the exact dependencies used for the rockspec" ..
    "being built into a luarocks.lock file in the current directory.")
+   parser:flag("--frozen", "Install the dependencies from the rocks and " ..
+   "rockspecs pinned in the luarocks.lock file, checking their digests, " ..
+   "without searching the rocks servers. Fails if a dependency has no " ..
+   "pinned rock or rockspec, instead of resolving it.")
    parser:flag("--no-manifest", "Skip creating/updating the manifest")
    parser:flag("--only-deps --deps-only", "Install only the dependencies of the rock.")
    util.deps_mode_option(parser)
@@ -117,6 +126,7 @@ function make.command(args)
       verify = not not args.verify,
       check_lua_versions = not not args.check_lua_versions,
       pin = not not args.pin,
+      frozen = not not args.frozen,
       rebuild = true,
       no_install = not not args.no_install,
    }
@@ -188,6 +188,10 @@ local function make_defaults(lua_version, target_cpu, platforms, home)
       no_manifest = false,
       check_certificates = false,
       wrap_bin_scripts = true,
+      loader_direct_paths = false,
+      loader_check_interval = 2,
+      lua_bytecode_cache = false,
+      shared_store_link = "auto",
 
       cache_timeout = 60,
       cache_fail_timeout = 86400,
@@ -218,6 +222,11 @@ local function make_defaults(lua_version, target_cpu, platforms, home)
 
       lua_extension = "lua",
       connection_timeout = 30,  -- 0 = no timeout
+      download_jobs = 4,  -- 1 = no parallel downloads
+      download_cache_size = 1024,  -- megabytes, 0 = no content-addressed cache
+      build_jobs = 1,
+      object_cache_size = 512,  -- megabytes
+      cmake_configure_cache = false,
 
       variables = {
          MAKE = os.getenv("MAKE") or "make",
@@ -260,6 +269,8 @@ local function make_defaults(lua_version, target_cpu, platforms, home)
          MD5SUM = "md5sum",
          OPENSSL = "openssl",
          MD5 = "md5",
+         SHA256SUM = "sha256sum",
+         SHASUM = "shasum",
          TOUCH = "touch",
 
          CMAKE = "cmake",
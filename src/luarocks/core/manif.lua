@@ -1,8 +1,10 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
 
 local manif = {}
 
 
+
+
 local persist = require("luarocks.core.persist")
 local cfg = require("luarocks.core.cfg")
 local dir = require("luarocks.core.dir")
@@ -23,9 +25,33 @@ local path = require("luarocks.core.path")
 
 
 
+
+
 local manifest_cache = {}
 
 
+local module_index_cache = {}
+
+
+
+local module_index_ids = {}
+
+
+local module_index_generation = 0
+
+
+
+manif.loader_index_file = "loader_index"
+
+
+
+
+manif.journal_file = "manifest.journal"
+
+
+local delta_fields = { "repository", "modules", "commands", "dependencies" }
+
+
 
 
 
@@ -44,6 +70,186 @@ function manif.get_cached_manifest(repo_url, lua_version)
    return manifest_cache[repo_url] and manifest_cache[repo_url][lua_version]
 end
 
+local function same_value(a, b)
+   if type(a) ~= "table" or type(b) ~= "table" then
+      return a == b
+   end
+   local ta, tb = a, b
+   for k, v in pairs(ta) do
+      if not same_value(v, tb[k]) then
+         return false
+      end
+   end
+   for k in pairs(tb) do
+      if ta[k] == nil then
+         return false
+      end
+   end
+   return true
+end
+
+
+
+
+
+
+
+
+function manif.make_delta(old, new)
+   local delta = {}
+   for _, field in ipairs(delta_fields) do
+      local old_entries = (old)[field]
+      local new_entries = (new)[field]
+      if old_entries or new_entries then
+         old_entries = old_entries or {}
+         new_entries = new_entries or {}
+         local changes = {}
+         for k, v in pairs(new_entries) do
+            if not same_value(old_entries[k], v) then
+               changes[k] = v
+            end
+         end
+         for k in pairs(old_entries) do
+            if new_entries[k] == nil then
+               changes[k] = false
+            end
+         end
+         delta[field] = changes
+      end
+   end
+   return delta
+end
+
+
+
+
+function manif.apply_delta(manifest, delta)
+   local tables = manifest
+   for _, field in ipairs(delta_fields) do
+      local changes = delta[field]
+      if changes and (tables[field] or next(changes)) then
+         local entries = tables[field] or {}
+         for k, v in pairs(changes) do
+            if v == false then
+               entries[k] = nil
+            else
+               entries[k] = v
+            end
+         end
+         tables[field] = entries
+      end
+   end
+end
+
+
+
+
+
+
+
+
+function manif.read_manifest_stamp(pathname)
+   local fd = io.open(pathname, "rb")
+   if not fd then
+      return nil
+   end
+   local size = fd:seek("end")
+   fd:seek("set", math.max(0, size - 64))
+   local tail = fd:read("*a")
+   fd:close()
+   return tail and tail:match("%-%- loader_index: (%w+)%s*$"), size
+end
+
+
+
+
+
+
+
+function manif.read_journal_base(pathname)
+   local fd = io.open(pathname, "rb")
+   if not fd then
+      return nil
+   end
+   local head = fd:read("*l")
+   fd:close()
+   return head and head:match("^%-%- base: (%w+)%s*$"), true
+end
+
+
+
+
+
+
+
+
+
+
+
+local function journal_applies(base, journal_base)
+   return base == nil or journal_base == base
+end
+
+
+
+
+
+
+function manif.journal_is_orphaned(repo_url)
+   local base, size = manif.read_manifest_stamp(dir.path(repo_url, "manifest"))
+   local _, exists = manif.read_journal_base(dir.path(repo_url, manif.journal_file))
+   return size ~= nil and base == nil and exists == true
+end
+
+
+
+
+
+
+
+
+local function load_journal(file)
+   local entries = {}
+   local env = setmetatable({}, {
+      __newindex = function(_, k, v)
+         if k == "entry" then
+            table.insert(entries, v)
+         end
+      end
+   })
+   local ok, err, errcode = persist.run_file(file, env)
+   if not ok then
+      if errcode == "open" then
+         return entries
+      end
+      return nil, err
+   end
+   return entries
+end
+
+
+
+
+
+
+
+
+
+local function replay_journal(manifest, file, base)
+   local journal_base, exists = manif.read_journal_base(file)
+   if not exists or not journal_applies(base, journal_base) then
+      return true
+   end
+   local entries, err = load_journal(file)
+   if not entries then
+      return nil, err
+   end
+   for _, e in ipairs(entries) do
+      manif.apply_delta(manifest, e)
+   end
+   return true
+end
+
 
 
 
@@ -64,6 +270,15 @@ function manif.manifest_loader(file, repo_url, lua_version)
       return nil, "Failed loading manifest for " .. repo_url .. ": " .. err, errcode
    end
 
+   local prefix = file:match("^(.-)manifest$")
+   if prefix and (prefix == "" or prefix:match("[/\\]$")) then
+      local base = manif.read_manifest_stamp(file)
+      local ok, jerr = replay_journal(manifest, prefix .. manif.journal_file, base)
+      if not ok then
+         return nil, "Failed loading manifest for " .. repo_url .. ": " .. jerr, "load"
+      end
+   end
+
    manif.cache_manifest(repo_url, lua_version, manifest)
    return manifest, err, errcode
 end
@@ -84,6 +299,246 @@ function manif.fast_load_local_manifest(repo_url)
    return manif.manifest_loader(pathname, repo_url, nil)
 end
 
+
+
+
+
+
+
+
+
+local function read_tree_stamp(repo_url)
+   local stamp, size = manif.read_manifest_stamp(dir.path(repo_url, "manifest"))
+   if not size then
+      return nil, "", false
+   end
+   local journal = dir.path(repo_url, manif.journal_file)
+   local _, journal_size = manif.read_manifest_stamp(journal)
+   if journal_size and not journal_applies(stamp, (manif.read_journal_base(journal))) then
+      journal_size = nil
+   end
+   return stamp, tostring(size) .. ":" .. tostring(journal_size or 0) .. ":" .. (stamp or ""), journal_size ~= nil
+end
+
+
+
+
+function manif.manifest_stamp_line(stamp)
+   return "-- loader_index: " .. stamp .. "\n"
+end
+
+
+
+
+function manif.journal_header_line(stamp)
+   return "-- base: " .. stamp .. "\n"
+end
+
+
+
+
+
+
+
+
+
+function manif.make_module_index(manifest, stamp)
+   local modules = {}
+   for module, entries in pairs(manifest.modules) do
+      local providers = {}
+      for i, entry in ipairs(entries) do
+         local name, version = entry:match("^([^/]*)/(.*)$")
+         local versions = manifest.repository[name]
+         local items = versions and versions[version]
+         local file_name = items and items[1] and items[1].modules and items[1].modules[module]
+         providers[i] = { name, version, file_name }
+      end
+      modules[module] = providers
+   end
+
+   local dependencies = {}
+   for name, versions in pairs(manifest.repository) do
+      for version, items in pairs(versions) do
+         local closure = items[1] and items[1].dependencies
+         if closure then
+            dependencies[name] = dependencies[name] or {}
+            dependencies[name][version] = closure
+         end
+      end
+   end
+
+   return { stamp = stamp, modules = modules, dependencies = dependencies }
+end
+
+
+
+
+
+
+
+
+
+
+function manif.apply_index_delta(index, delta)
+   local repository = (delta.repository or {})
+
+   for module, value in pairs(delta.modules or {}) do
+      if value == false then
+         index.modules[module] = nil
+      else
+         local previous = index.modules[module] or {}
+         local providers = {}
+         for i, entry in ipairs(value) do
+            local name, version = entry:match("^([^/]*)/(.*)$")
+            local versions = repository[name]
+            local file_name
+            if type(versions) == "table" then
+               local items = versions[version]
+               file_name = items and items[1] and items[1].modules and items[1].modules[module]
+            else
+               local found = false
+               for _, provider in ipairs(previous) do
+                  if provider[1] == name and provider[2] == version then
+                     file_name, found = provider[3], true
+                     break
+                  end
+               end
+               if not found then
+                  return false
+               end
+            end
+            providers[i] = { name, version, file_name }
+         end
+         index.modules[module] = providers
+      end
+   end
+
+   for name, versions in pairs(repository) do
+      local closures
+      if type(versions) == "table" then
+         for version, items in pairs(versions) do
+            local closure = items[1] and items[1].dependencies
+            if closure then
+               closures = closures or {}
+               closures[version] = closure
+            end
+         end
+      end
+      index.dependencies[name] = closures
+   end
+   return true
+end
+
+
+
+
+
+
+
+
+function manif.fast_load_local_module_index(repo_url)
+   local cached_index = module_index_cache[repo_url]
+   if cached_index then
+      return cached_index
+   end
+
+   local stamp, id, journaled = read_tree_stamp(repo_url)
+   module_index_ids[repo_url] = id
+
+   local index = persist.load_into_table(dir.path(repo_url, manif.loader_index_file))
+   if index and index.stamp and index.modules and index.dependencies and index.stamp == stamp then
+      if journaled then
+         local entries = load_journal(dir.path(repo_url, manif.journal_file))
+         for _, e in ipairs(entries or {}) do
+            if not manif.apply_index_delta(index, e) then
+               index = nil
+               break
+            end
+         end
+         if not entries then
+            index = nil
+         end
+      end
+   else
+      index = nil
+   end
+   if not index then
+      local manifest = manif.fast_load_local_manifest(repo_url)
+      if not manifest then
+         return nil
+      end
+      index = manif.make_module_index(manifest)
+   end
+
+   module_index_cache[repo_url] = index
+   return index
+end
+
+
+
+
+
+
+
+function manif.cache_module_index(repo_url, index)
+   module_index_cache[repo_url] = index
+   local _, id = read_tree_stamp(repo_url)
+   module_index_ids[repo_url] = index and id
+   module_index_generation = module_index_generation + 1
+end
+
+
+
+
+
+function manif.journal_module_index(repo_url, delta)
+   local index = module_index_cache[repo_url]
+   if index and not manif.apply_index_delta(index, delta) then
+      index = nil
+   end
+   manif.cache_module_index(repo_url, index)
+end
+
+
+
+
+
+
+
+function manif.module_index_is_current(repo_url)
+   local id = module_index_ids[repo_url]
+   local _, current = read_tree_stamp(repo_url)
+   if id and id == current then
+      return true
+   end
+   module_index_cache[repo_url] = nil
+   module_index_ids[repo_url] = nil
+   if manifest_cache[repo_url] then
+      manifest_cache[repo_url][cfg.lua_version] = nil
+   end
+   module_index_generation = module_index_generation + 1
+   return false
+end
+
+
+
+
+function manif.get_module_index_generation()
+   return module_index_generation
+end
+
+function manif.load_rocks_tree_module_indexes(deps_mode)
+   local trees = {}
+   path.map_trees(deps_mode, function(tree)
+      local rocks_dir = path.rocks_dir(tree)
+      local index = manif.fast_load_local_module_index(rocks_dir)
+      if index then
+         table.insert(trees, { tree = tree, rocks_dir = rocks_dir, index = index })
+      end
+   end)
+   return trees
+end
+
 function manif.load_rocks_tree_manifests(deps_mode)
    local trees = {}
    path.map_trees(deps_mode, function(tree)
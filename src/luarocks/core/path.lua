@@ -120,6 +120,41 @@ function path.which_i(file_name, name, version, tree, i)
    return file_name
 end
 
+
+
+
+
+
+
+
+
+function path.bytecode_dir(name, version, tree)
+   assert(not name:match(dir_sep))
+   return dir.path(path.rocks_dir(tree) .. "-bytecode", name, version)
+end
+
+
+
+
+
+
+
+
+function path.bytecode_file(name, version, hash, tree)
+   return dir.path(path.bytecode_dir(name, version, tree), hash .. ".luac")
+end
+
+
+
+
+
+
+
+
+function path.bytecode_stamps_file(name, version, tree)
+   return dir.path(path.bytecode_dir(name, version, tree), "stamps")
+end
+
 function path.rocks_tree_to_string(tree)
    if type(tree) == "string" then
       return tree
@@ -1,5 +1,12 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local debug = _tl_compat and _tl_compat.debug or debug; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local package = _tl_compat and _tl_compat.package or package; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
-local util = {}
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local debug = _tl_compat and _tl_compat.debug or debug; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local package = _tl_compat and _tl_compat.package or package; local pairs = _tl_compat and _tl_compat.pairs or pairs; local pcall = _tl_compat and _tl_compat.pcall or pcall; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
+local util = { FileStamp = {} }
+
+
+
+
+
+
+
 
 
 
@@ -357,4 +364,33 @@ function util.starts_with(s, prefix)
    return s:sub(1, #prefix) == prefix
 end
 
+local lfs_ok
+local lfs
+
+
+
+
+
+
+
+function util.file_stamp(file)
+   if lfs_ok == nil then
+      lfs_ok, lfs = pcall(require, "lfs")
+   end
+   if lfs_ok then
+      local attrs = lfs.attributes(file)
+      if not attrs then
+         return nil
+      end
+      return { size = math.floor(attrs.size), mtime = attrs.modification }
+   end
+   local fd = io.open(file, "rb")
+   if not fd then
+      return nil
+   end
+   local size = fd:seek("end")
+   fd:close()
+   return { size = size }
+end
+
 return util
@@ -1,4 +1,10 @@
-local type = type; local deplocks = {}
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local table = _tl_compat and _tl_compat.table or table; local type = type; local deplocks = {}
+
+
+
+
+
+
 
 
 
@@ -7,7 +13,9 @@ local type = type; local deplocks = {}
 
 
 local fs = require("luarocks.fs")
+local cfg = require("luarocks.core.cfg")
 local dir = require("luarocks.dir")
+local path = require("luarocks.path")
 local util = require("luarocks.util")
 local persist = require("luarocks.persist")
 
@@ -16,9 +24,13 @@ local persist = require("luarocks.persist")
 
 local depstable = {}
 local depstable_mode = "start"
+
+local installed_urls = {}
 local deplock_abs_filename
 local deplock_root_rock_name
 
+local artifacts_dir
+
 function deplocks.init(root_rock_name, dirname)
    if depstable_mode ~= "start" then
       return
@@ -99,11 +111,148 @@ function deplocks.get(depskey, name)
    return nil
 end
 
+
+
+
+function deplocks.add_url(name, version, url)
+   if depstable_mode == "create" then
+      installed_urls[name .. " " .. version] = url
+   end
+end
+
+
+
+
+
+function deplocks.use_artifacts_from(dirname)
+   artifacts_dir = dirname
+end
+
+
+
+
+
+
+
+function deplocks.get_artifact(name, version)
+   local versions = depstable.artifacts and depstable.artifacts[name]
+   local artifact = versions and versions[version]
+   if artifact and type(artifact.url) == "string" and type(artifact.sha256) == "string" then
+      if artifacts_dir then
+         local copy = dir.path(artifacts_dir, dir.base_name(artifact.url))
+         if fs.exists(copy) then
+            local src_rock
+            if copy:match("%.rockspec$") then
+               src_rock = copy:gsub("%.rockspec$", ".src.rock")
+               if not fs.exists(src_rock) then
+                  src_rock = nil
+               end
+            end
+            return copy, artifact.sha256, src_rock
+         end
+      end
+      return artifact.url, artifact.sha256
+   end
+   return nil
+end
+
+
+
+
+
+
+
+
+
+
+
+local function is_portable(url)
+   local _, _, arch = path.parse_name(url)
+   return arch == "rockspec" or arch == "src" or arch == "all"
+end
+
+
+
+
+
+
+
+
+local function pin_artifacts()
+   local fetch = require("luarocks.fetch")
+   local search = require("luarocks.search")
+   local queries = require("luarocks.queries")
+
+   local pins = {}
+   local seen = {}
+   local depskeys = { "dependencies", "build_dependencies", "test_dependencies" }
+   for _, depskey in ipairs(depskeys) do
+      for name, version in deplocks.each(depskey) do
+         local key = name .. " " .. version
+         if not seen[key] then
+            seen[key] = true
+            local url = installed_urls[key]
+            if not (url and is_portable(url)) then
+               local dname, dnamespace = util.split_namespace(name)
+               url = search.find_suitable_rock(queries.new(dname, dnamespace, version, false, "src|rockspec|all")) or
+               url or
+               search.find_suitable_rock(queries.new(dname, dnamespace, version))
+               if url and not is_portable(url) then
+                  util.warning("Only a binary rock was found for " .. key .. "; it can only be installed with --frozen on " .. cfg.arch)
+               end
+            end
+            if url then
+               table.insert(pins, { name = name, version = version, url = url })
+            else
+               util.warning("Could not find " .. key .. " in the rocks servers; it cannot be installed with --frozen")
+            end
+         end
+      end
+   end
+
+   local urls = {}
+   for i, pin in ipairs(pins) do
+      urls[i] = pin.url
+   end
+   fetch.prefetch(urls)
+
+   local files = {}
+   for _, pin in ipairs(pins) do
+      local file, err = fetch.fetch_url_at_temp_dir(pin.url, "luarocks-lock", nil, true)
+      if file then
+         pin.file = file
+         table.insert(files, file)
+      else
+         util.warning("Could not pin " .. pin.url .. ": " .. err)
+      end
+   end
+
+   local artifacts = {}
+   local sums
+   if #files > 0 then
+      sums = fs.get_checksums(files, "sha256")
+   end
+   if sums then
+      for _, pin in ipairs(pins) do
+         local sha256 = pin.file and sums[pin.file]
+         if sha256 then
+            artifacts[pin.name] = artifacts[pin.name] or {}
+            artifacts[pin.name][pin.version] = { url = pin.url, sha256 = sha256 }
+         end
+      end
+   end
+   if next(artifacts) then
+      return artifacts
+   end
+end
+
 function deplocks.write_file()
    if depstable_mode ~= "create" then
       return true
    end
 
+   depstable.artifacts = pin_artifacts()
+
    return persist.save_as_module(deplock_abs_filename, depstable)
 end
 
@@ -13,6 +13,9 @@ local util = require("luarocks.util")
 local vers = require("luarocks.core.vers")
 local queries = require("luarocks.queries")
 local deplocks = require("luarocks.deplocks")
+local solver = require("luarocks.deps.solver")
+
+
 
 
 
@@ -274,6 +277,241 @@ local function check_supported_platforms(rockspec)
    return true
 end
 
+local function print_no_upgrade_hint(name, depq)
+   util.printerr("This version of " .. name .. " is designed for use with")
+   util.printerr(tostring(depq) .. ", but is configured to avoid upgrading it")
+   util.printerr("automatically. Please upgrade " .. depq.name .. " with")
+   util.printerr("   luarocks install " .. depq.name)
+   util.printerr("or look for a suitable version of " .. name .. " with")
+   util.printerr("   luarocks search " .. name)
+end
+
+
+
+
+
+local function prefetch_plan(plan)
+   local fetch = require("luarocks.fetch")
+   local rock_cache = require("luarocks.rock_cache")
+
+   local urls = {}
+   local rockspec_urls = {}
+   for _, step in ipairs(plan) do
+      if step.url then
+         table.insert(urls, step.url)
+         if step.url:match("%.rockspec$") then
+            table.insert(rockspec_urls, step.url)
+         end
+      end
+   end
+   fetch.prefetch(urls)
+
+   local sources = {}
+   for _, url in ipairs(rockspec_urls) do
+      local rockspec = fetch.load_rockspec(url)
+      if rockspec and rockspec.source.url then
+
+         local entry = rock_cache.entry_dir(rockspec)
+         if not (entry and rock_cache.find(entry)) then
+            table.insert(sources, rockspec.source.url)
+         end
+      end
+   end
+   fetch.prefetch(sources)
+end
+
+
+
+
+
+
+
+
+
+
+
+
+
+local function load_pin_rockspec(pin)
+   local fetch = require("luarocks.fetch")
+   local fs = require("luarocks.fs")
+
+   if pin.arch == "rockspec" then
+      return fetch.load_local_rockspec(pin.file, true)
+   end
+   local rockspec_name = path.rockspec_name_from_rock(pin.file)
+   local unpack_dir, err = fetch.fetch_and_unpack_rock(pin.file, nil, nil, { rockspec_name })
+   if not unpack_dir then
+      return nil, err
+   end
+   local rockspec_file = dir.path(unpack_dir, rockspec_name)
+   if not fs.exists(rockspec_file) then
+      return nil, "the rock does not contain its rockspec, " .. rockspec_name
+   end
+   return fetch.load_local_rockspec(rockspec_file, true)
+end
+
+
+
+
+
+
+
+
+local function order_pins(pins, rocks_provided)
+   local get_versions = prepare_get_versions("none", rocks_provided, "build_dependencies")
+   local by_name = {}
+   for _, pin in ipairs(pins) do
+      by_name[pin.query.name] = pin
+   end
+
+   local ordered = {}
+   local state = {}
+   local function visit(pin)
+      if state[pin] == "done" then
+         return true
+      elseif state[pin] == "visiting" then
+         return nil, "The pinned dependency " .. tostring(pin.query) .. " needs itself to be built"
+      end
+      state[pin] = "visiting"
+      if pin.rockspec then
+         for _, depq in ipairs(pin.rockspec.build_dependencies.queries) do
+            local dep_pin = by_name[depq.name]
+            if dep_pin then
+               local ok, err = visit(dep_pin)
+               if not ok then
+                  return nil, err
+               end
+            else
+               local found = false
+               for _, v in ipairs((get_versions(depq))) do
+                  if vers.match_constraints(vers.parse_version(v), depq.constraints) then
+                     found = true
+                     break
+                  end
+               end
+               if not found then
+                  return nil, "Build dependency " .. tostring(depq) .. " of " .. tostring(pin.query) .. " is neither installed nor pinned in the lockfile; recreate it with --pin"
+               end
+            end
+         end
+      end
+      state[pin] = "done"
+      table.insert(ordered, pin)
+      return true
+   end
+
+   local sources = {}
+   for _, pin in ipairs(pins) do
+      if pin.arch == "rockspec" or pin.arch == "src" then
+         local err
+         pin.rockspec, err = load_pin_rockspec(pin)
+         if not pin.rockspec then
+            return nil, "Failed loading rockspec of pinned dependency " .. pin.url .. ": " .. err
+         end
+         table.insert(sources, pin)
+      else
+         visit(pin)
+      end
+   end
+   for _, pin in ipairs(sources) do
+      local ok, err = visit(pin)
+      if not ok then
+         return nil, err
+      end
+   end
+   return ordered
+end
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+local function fulfill_frozen(depskey, rocks_provided, verify)
+   local fetch = require("luarocks.fetch")
+   local fs = require("luarocks.fs")
+
+   local get_versions = prepare_get_versions("none", rocks_provided, depskey)
+   local pins = {}
+   for dnsname, dversion in deplocks.each(depskey) do
+      local dname, dnamespace = util.split_namespace(dnsname)
+      local depq = queries.new(dname, dnamespace, dversion)
+      local _, locations, _, provided = get_versions(depq)
+      if not (provided or locations[dversion]) then
+         local url, sha256, src_rock = deplocks.get_artifact(dnsname, dversion)
+         if not url then
+            return nil, "No artifact pinned for " .. tostring(depq) .. " in the lockfile; recreate it with --pin"
+         end
+         local _, _, arch = path.parse_name(url)
+         if arch and arch ~= "rockspec" and arch ~= "src" and arch ~= "all" and arch ~= cfg.arch then
+            return nil, "The artifact pinned for " .. tostring(depq) .. " in the lockfile, " .. url .. ", is built for " .. arch .. ", not for " .. cfg.arch .. "; recreate the lockfile with --pin on this platform", "arch"
+         end
+         table.insert(pins, { query = depq, url = url, sha256 = sha256, arch = arch, src_rock = src_rock })
+      end
+   end
+   if #pins == 0 then
+      return true
+   end
+
+   local urls = {}
+   for i, pin in ipairs(pins) do
+      urls[i] = pin.url
+   end
+   fetch.prefetch(urls)
+
+   local files = {}
+   for i, pin in ipairs(pins) do
+      local file, err, errcode = fetch.fetch_url_at_temp_dir(pin.url, "luarocks-frozen", nil, true)
+      if not file then
+         return nil, "Failed fetching pinned dependency " .. pin.url .. ": " .. err, errcode
+      end
+      pin.file = file
+      files[i] = file
+   end
+   local sums, err = fs.get_checksums(files, "sha256")
+   if not sums then
+      return nil, err
+   end
+   for _, pin in ipairs(pins) do
+      local sha256 = sums[pin.file]
+      if sha256 ~= pin.sha256 then
+         return nil, "Digest mismatch for pinned dependency " .. pin.url .. ": expected sha256 " .. pin.sha256 .. ", got " .. tostring(sha256)
+      end
+   end
+
+   local ordered, order_err = order_pins(pins, rocks_provided)
+   if not ordered then
+      return nil, order_err
+   end
+
+   for _, pin in ipairs(ordered) do
+      util.printout("Installing " .. pin.url)
+
+
+
+      local install_args = {
+         rock = pin.src_rock or pin.file,
+         deps_mode = "none",
+         namespace = pin.query.namespace,
+         verify = verify,
+      }
+      local ok, install_err, errcode = deps.installer(install_args)
+      if not ok then
+         return nil, "Failed installing dependency: " .. pin.url .. " - " .. install_err, errcode
+      end
+   end
+   return true
+end
+
 
 
 
@@ -286,13 +524,25 @@ end
 
 
 
-function deps.fulfill_dependencies(rockspec, depskey, deps_mode, verify, deplock_dir)
+
+
+function deps.fulfill_dependencies(rockspec, depskey, deps_mode, verify, deplock_dir, frozen)
    local name = rockspec.name
    local version = rockspec.version
    local rocks_provided = rockspec.rocks_provided
 
    local ok, filename, err = deplocks.load(name, deplock_dir or ".")
-   if filename then
+   if frozen then
+
+      local lockfile = filename or deplocks.get_abs_filename(name)
+      if not lockfile then
+         return nil, err or ("--frozen needs a luarocks.lock file for " .. name .. " " .. version)
+      end
+      if filename then
+         util.printout("Installing dependencies pinned in lockfile: " .. filename)
+      end
+      return fulfill_frozen(depskey, rocks_provided, verify)
+   elseif filename then
       util.printout("Using dependencies pinned in lockfile: " .. filename)
 
       local get_versions = prepare_get_versions("none", rocks_provided, depskey)
@@ -319,12 +569,44 @@ function deps.fulfill_dependencies(rockspec, depskey, deps_mode, verify, deplock
       return nil, err
    end
 
-   deps.report_missing_dependencies(name, version, (rockspec)[depskey].queries, deps_mode, rocks_provided)
+   local dependencies = (rockspec)[depskey].queries
+
+   deps.report_missing_dependencies(name, version, dependencies, deps_mode, rocks_provided)
 
    util.printout()
 
+
+
+   local plan, plan_err, conflict = solver.solve(dependencies, deps_mode, rocks_provided, name, version)
+   if not plan then
+      for _, depq in ipairs(dependencies) do
+         if depq.name == conflict and depq.constraints and depq.constraints[1] and depq.constraints[1].no_upgrade then
+            print_no_upgrade_hint(name, depq)
+            break
+         end
+      end
+      return nil, "Could not satisfy dependencies of " .. name .. " " .. version .. ": " .. plan_err
+   end
+   prefetch_plan(plan)
+   for _, step in ipairs(plan) do
+      if step.url then
+         deplocks.add_url(step.name, step.version, step.url)
+         util.printout("Installing " .. step.url)
+         local install_args = {
+            rock = step.url,
+            deps_mode = deps_mode,
+            namespace = step.namespace,
+            verify = verify,
+         }
+         local install_ok, install_err, errcode = deps.installer(install_args)
+         if not install_ok then
+            return nil, "Failed installing dependency: " .. step.url .. " - " .. install_err, errcode
+         end
+      end
+   end
+
    local get_versions = prepare_get_versions(deps_mode, rocks_provided, depskey)
-   for _, depq in ipairs((rockspec)[depskey].queries) do
+   for _, depq in ipairs(dependencies) do
 
       util.printout(("%s %s depends on %s (%s)"):format(
       name, version, tostring(depq), (rock_status(depq, get_versions))))
@@ -337,12 +619,7 @@ function deps.fulfill_dependencies(rockspec, depskey, deps_mode, verify, deplock
          end
       else
          if depq.constraints and depq.constraints[1] and depq.constraints[1].no_upgrade then
-            util.printerr("This version of " .. name .. " is designed for use with")
-            util.printerr(tostring(depq) .. ", but is configured to avoid upgrading it")
-            util.printerr("automatically. Please upgrade " .. depq.name .. " with")
-            util.printerr("   luarocks install " .. depq.name)
-            util.printerr("or look for a suitable version of " .. name .. " with")
-            util.printerr("   luarocks search " .. name)
+            print_no_upgrade_hint(name, depq)
          end
          return nil, version_or_err
       end
@@ -0,0 +1,456 @@
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local pairs = _tl_compat and _tl_compat.pairs or pairs; local table = _tl_compat and _tl_compat.table or table
+
+
+
+
+
+local solver = { Step = {} }
+
+
+
+
+
+
+
+
+
+
+
+local cfg = require("luarocks.core.cfg")
+local manif = require("luarocks.manif")
+local path = require("luarocks.path")
+local fetch = require("luarocks.fetch")
+local search = require("luarocks.search")
+local queries = require("luarocks.queries")
+local util = require("luarocks.util")
+local vers = require("luarocks.core.vers")
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+local function matches(s, dep, version)
+   local key = tostring(dep)
+   local memo = s.matches[key]
+   if not memo then
+      memo = {}
+      s.matches[key] = memo
+   end
+   local ok = memo[version]
+   if ok == nil then
+      ok = vers.match_constraints(vers.parse_version(version), dep.constraints)
+      memo[version] = ok
+   end
+   return ok
+end
+
+local function sort_candidates(list)
+   table.sort(list, function(a, b)
+      return a.parsed > b.parsed
+   end)
+end
+
+
+
+local function installed_candidates(s, name)
+   local list = s.installed[name]
+   if list then
+      return list
+   end
+   list = {}
+   local provided = s.rocks_provided[name]
+   if provided then
+      table.insert(list, { version = provided, parsed = vers.parse_version(provided), provided = true })
+   else
+      local versions, locations = manif.get_versions(queries.new(name, s.namespaces[name]), s.deps_mode)
+      for _, v in ipairs(versions) do
+         table.insert(list, { version = v, parsed = vers.parse_version(v), tree = locations[v] })
+      end
+      sort_candidates(list)
+   end
+   s.installed[name] = list
+   return list
+end
+
+
+
+local function remote_candidates(s, name)
+   local list = s.remote[name]
+   if list then
+      return list
+   end
+   list = {}
+   if not s.rocks_provided[name] then
+      local installed = {}
+      for _, c in ipairs(installed_candidates(s, name)) do
+         installed[c.version] = true
+      end
+      local result_tree = search.search_repos(queries.new(name, s.namespaces[name]))
+      for version, items in pairs(result_tree[name] or {}) do
+         if not installed[version] then
+            local url = search.pick_rock_url(name, version, items)
+            if url then
+               local rockspec_url
+               for _, item in ipairs(items) do
+                  if item.arch == "rockspec" then
+                     rockspec_url = path.make_url(item.repo, name, version, "rockspec")
+                     break
+                  end
+               end
+               table.insert(list, { version = version, parsed = vers.parse_version(version), url = url, rockspec_url = rockspec_url })
+            end
+         end
+      end
+      sort_candidates(list)
+   end
+   s.remote[name] = list
+   return list
+end
+
+
+
+
+
+local function candidate_dependencies(s, name, c)
+   if c.provided or c.root then
+      return {}
+   end
+   local key = name .. " " .. c.version
+   local list = s.dependencies[key]
+   if list then
+      return list
+   end
+   if c.tree then
+      local manifest = manif.load_manifest(path.rocks_dir(c.tree))
+      list = manifest and manifest.dependencies and manifest.dependencies[name] and manifest.dependencies[name][c.version]
+      if not list then
+         local rockspec = fetch.load_local_rockspec(path.rockspec_file(name, c.version, c.tree), false)
+         list = rockspec and rockspec.dependencies.queries
+      end
+   elseif c.rockspec_url then
+      local rockspec = fetch.load_rockspec(c.rockspec_url)
+      list = rockspec and rockspec.dependencies.queries
+   end
+   s.dependencies[key] = list
+   return list
+end
+
+
+
+local function failed_requirement(s, name, c)
+   for _, req in ipairs(s.required[name] or {}) do
+      if not matches(s, req.query, c.version) then
+         return req
+      end
+   end
+end
+
+local function no_upgrade(s, name)
+   for _, req in ipairs(s.required[name] or {}) do
+      local constraints = req.query.constraints
+      if constraints and constraints[1] and constraints[1].no_upgrade then
+         return true
+      end
+   end
+   return false
+end
+
+
+
+
+
+local function viable(s, name, include_remote)
+   local list = {}
+   for _, c in ipairs(installed_candidates(s, name)) do
+      if not (s.dead[name .. " " .. c.version] or failed_requirement(s, name, c)) then
+         table.insert(list, c)
+      end
+   end
+   if (include_remote or #list == 0) and not no_upgrade(s, name) then
+      for _, c in ipairs(remote_candidates(s, name)) do
+         if not (s.dead[name .. " " .. c.version] or failed_requirement(s, name, c)) then
+            table.insert(list, c)
+         end
+      end
+   end
+   return list
+end
+
+
+local function explain(s, name)
+   local lines = {}
+   for _, req in ipairs(s.required[name]) do
+      table.insert(lines, "   " .. tostring(req.query) .. " (required by " .. req.label .. ")")
+   end
+   local available = {}
+   for _, c in ipairs(installed_candidates(s, name)) do
+      table.insert(available, c.version .. (c.provided and " (provided)" or " (installed)"))
+   end
+   if not no_upgrade(s, name) then
+      for _, c in ipairs(remote_candidates(s, name)) do
+         table.insert(available, c.version)
+      end
+   end
+   if #available == 0 then
+      return "No results matching query were found for Lua " .. cfg.lua_version .. ":\n" .. table.concat(lines, "\n")
+   end
+   return "No version of " .. name .. " satisfies all constraints:\n" .. table.concat(lines, "\n") ..
+   "\nAvailable versions: " .. table.concat(available, ", ")
+end
+
+local function require_deps(s, by, label, dependencies)
+   local added = {}
+   for _, dep in ipairs(dependencies) do
+      s.required[dep.name] = s.required[dep.name] or {}
+      table.insert(s.required[dep.name], { query = dep, by = by, label = label })
+      if dep.namespace then
+         s.namespaces[dep.name] = dep.namespace
+      end
+      table.insert(added, dep.name)
+   end
+   return added
+end
+
+local function unrequire(s, added)
+   for i = #added, 1, -1 do
+      local reqs = s.required[added[i]]
+      table.remove(reqs)
+      if #reqs == 0 then
+         s.required[added[i]] = nil
+      end
+   end
+end
+
+
+local function add_requirers(s, name, conflict)
+   for _, req in ipairs(s.required[name] or {}) do
+      if req.by then
+         conflict[req.by] = true
+      end
+   end
+end
+
+
+
+
+
+
+
+
+
+
+local function resolve(s)
+
+   local best, best_list
+   for name in pairs(s.required) do
+      if not s.selected[name] then
+         local list = viable(s, name, false)
+         if #list == 0 then
+            s.conflict = explain(s, name)
+            s.conflict_name = name
+            local conflict = {}
+            add_requirers(s, name, conflict)
+            return false, conflict
+         end
+         if not best or #list < #best_list or (#list == #best_list and name < best) then
+            best, best_list = name, list
+         end
+      end
+   end
+   if not best then
+      return true
+   end
+
+   local conflict = {}
+   local tried = {}
+   local function try(c)
+      tried[c.version] = true
+      local dependencies = candidate_dependencies(s, best, c) or {}
+      for _, dep in ipairs(dependencies) do
+         local other = s.selected[dep.name]
+         if other and not matches(s, dep, other.version) then
+            s.conflict = best .. " " .. c.version .. " depends on " .. tostring(dep) ..
+            ", but " .. dep.name .. " " .. other.version .. " was selected"
+            s.conflict_name = dep.name
+            if not other.root then
+               conflict[dep.name] = true
+            end
+            return false
+         end
+      end
+      s.selected[best] = c
+      local added = require_deps(s, best, best .. " " .. c.version, dependencies)
+      local ok, sub = resolve(s)
+      if ok then
+         return true
+      end
+      unrequire(s, added)
+      s.selected[best] = nil
+      if not sub[best] then
+
+         conflict = sub
+         return false, true
+      end
+      sub[best] = nil
+      if not next(sub) then
+         s.dead[best .. " " .. c.version] = true
+      end
+      for name in pairs(sub) do
+         conflict[name] = true
+      end
+      return false
+   end
+
+   for _, c in ipairs(best_list) do
+      local ok, jump = try(c)
+      if ok then
+         return true
+      elseif jump then
+         return false, conflict
+      end
+   end
+   for _, c in ipairs(viable(s, best, true)) do
+      if not tried[c.version] then
+         local ok, jump = try(c)
+         if ok then
+            return true
+         elseif jump then
+            return false, conflict
+         end
+      end
+   end
+   add_requirers(s, best, conflict)
+   return false, conflict
+end
+
+
+local function make_plan(s)
+   local plan = {}
+   local visited = {}
+   local function visit(name)
+      if visited[name] then
+         return
+      end
+      visited[name] = true
+      local c = s.selected[name]
+      for _, dep in ipairs(candidate_dependencies(s, name, c) or {}) do
+         if s.selected[dep.name] then
+            visit(dep.name)
+         end
+      end
+      if c.root then
+         return
+      end
+      local requirers = {}
+      for _, req in ipairs(s.required[name]) do
+         table.insert(requirers, req.label)
+      end
+      table.insert(plan, {
+         name = name,
+         namespace = s.namespaces[name],
+         version = c.version,
+         url = c.url,
+         tree = c.tree,
+         provided = c.provided,
+         requirers = requirers,
+      })
+   end
+   for name in util.sortedpairs(s.selected) do
+      visit(name)
+   end
+   return plan
+end
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+function solver.solve(dependencies, deps_mode, rocks_provided, name, version)
+   if deps_mode == "none" then
+      deps_mode = "one"
+   end
+   local s = {
+      deps_mode = deps_mode,
+      rocks_provided = rocks_provided or {},
+      namespaces = {},
+      installed = {},
+      remote = {},
+      dependencies = {},
+      matches = {},
+      required = {},
+      selected = {},
+      dead = {},
+   }
+   local label = "the command line"
+   if name then
+      label = name .. " " .. version
+      s.selected[name] = { version = version, parsed = vers.parse_version(version), root = true }
+   end
+   require_deps(s, nil, label, dependencies)
+   if not resolve(s) then
+      return nil, s.conflict, s.conflict_name
+   end
+   return make_plan(s)
+end
+
+
+
+function solver.print_plan(plan)
+   util.printout("Installation plan:")
+   for _, step in ipairs(plan) do
+      local status
+      if step.provided then
+         status = "provided by VM"
+      elseif step.url then
+         status = "install from " .. step.url
+      else
+         status = "installed"
+      end
+      util.printout(("   %s %s (%s), required by %s"):format(step.name, step.version, status, table.concat(step.requirers, ", ")))
+   end
+end
+
+return solver
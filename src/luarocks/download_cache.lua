@@ -0,0 +1,413 @@
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local pairs = _tl_compat and _tl_compat.pairs or pairs; local table = _tl_compat and _tl_compat.table or table
+
+
+
+
+
+
+
+local download_cache = { Stats = {} }
+
+
+
+
+
+
+
+local fs = require("luarocks.fs")
+local dir = require("luarocks.dir")
+local persist = require("luarocks.persist")
+local util = require("luarocks.util")
+local cfg = require("luarocks.core.cfg")
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+local index
+local pending
+local flush_scheduled = false
+
+local function new_index()
+   return { urls = {}, names = {}, objects = {} }
+end
+
+
+
+local function store_dir()
+   if not cfg.local_cache or (cfg.download_cache_size or 0) <= 0 then
+      return nil
+   end
+   return dir.path(cfg.local_cache, "content")
+end
+
+local function object_path(store, digest)
+   return dir.path(store, "objects", digest:sub(1, 2), digest)
+end
+
+
+
+
+
+
+local function name_of(url)
+   local name = dir.base_name(url)
+   if not (name:match("%.rock$") or name:match("%.rockspec$")) then
+      return nil
+   end
+   for _, item in ipairs(cfg.rocks_servers) do
+      local mirrors
+      if type(item) == "table" then
+         mirrors = item
+      else
+         mirrors = { item }
+      end
+      for _, mirror in ipairs(mirrors) do
+         local base = (mirror:gsub("/*$", "/"))
+         if url:sub(1, #base) == base then
+            return (mirrors[1]:gsub("/*$", "/")) .. url:sub(#base + 1)
+         end
+      end
+   end
+end
+
+
+
+local function is_cacheable(url)
+   local name = dir.base_name(url)
+   return not (name:match("%-scm%-%d+%.") or name:match("%-dev%-%d+%."))
+end
+
+local function file_size(filename)
+   local fd = io.open(filename, "rb")
+   if not fd then
+      return 0
+   end
+   local size = fd:seek("end")
+   fd:close()
+   return size
+end
+
+local function load_index(store)
+   local idx = new_index()
+   local tbl = persist.load_into_table(dir.path(store, "index"))
+   if tbl then
+      idx.urls = tbl.urls or idx.urls
+      idx.names = tbl.names or idx.names
+      idx.objects = tbl.objects or idx.objects
+   end
+   return idx
+end
+
+local function get_index(store)
+   if not index then
+      index = load_index(store)
+      pending = new_index()
+   end
+   return index
+end
+
+
+
+
+
+local function evict(store, idx, max_bytes)
+   local total = 0
+   local digests = {}
+   for digest, obj in pairs(idx.objects) do
+      if fs.exists(object_path(store, digest)) then
+         total = total + obj.size
+         table.insert(digests, digest)
+      else
+         idx.objects[digest] = nil
+      end
+   end
+   table.sort(digests, function(a, b)
+      return idx.objects[a].used < idx.objects[b].used
+   end)
+   local removed = 0
+   for _, digest in ipairs(digests) do
+      if total <= max_bytes then
+         break
+      end
+      os.remove(object_path(store, digest))
+      total = total - idx.objects[digest].size
+      idx.objects[digest] = nil
+      removed = removed + 1
+   end
+   for _, map in ipairs({ idx.urls, idx.names }) do
+      for key, digest in pairs(map) do
+         if not idx.objects[digest] then
+            map[key] = nil
+         end
+      end
+   end
+   return removed, total
+end
+
+
+
+
+
+
+local function save_index(store, max_bytes)
+   local lock, err = fs.lock_access(store)
+   if not lock then
+      return nil, "Failed locking download cache: " .. tostring(err)
+   end
+   local idx = load_index(store)
+   if pending then
+      for url, digest in pairs(pending.urls) do
+         idx.urls[url] = digest
+      end
+      for name, digest in pairs(pending.names) do
+         idx.names[name] = digest
+      end
+      for digest, obj in pairs(pending.objects) do
+         local known = idx.objects[digest]
+         if known then
+            known.used = math.max(known.used, obj.used)
+         else
+            idx.objects[digest] = obj
+         end
+      end
+   end
+   local removed, total = evict(store, idx, max_bytes or cfg.download_cache_size * 1024 * 1024)
+
+   local index_file = dir.path(store, "index")
+   local temp_file = index_file .. ".tmp"
+   local ok
+   ok, err = persist.save_from_table(temp_file, idx)
+   if ok then
+      ok, err = os.rename(temp_file, index_file)
+   end
+   fs.unlock_access(lock)
+   if not ok then
+      return nil, "Failed writing download cache index: " .. tostring(err)
+   end
+   index = idx
+   pending = new_index()
+   return removed, total
+end
+
+
+function download_cache.flush()
+   local store = store_dir()
+   if store and pending and next(pending.objects) then
+      save_index(store)
+   end
+end
+
+local function record_use(digest, url, size)
+   local name = name_of(url)
+   index.urls[url] = digest
+   pending.urls[url] = digest
+   if name then
+      index.names[name] = digest
+      pending.names[name] = digest
+   end
+   local obj = index.objects[digest] or { size = size }
+   obj.used = os.time()
+   index.objects[digest] = obj
+   pending.objects[digest] = { size = obj.size, used = obj.used }
+   if not flush_scheduled then
+      util.schedule_function(download_cache.flush)
+      flush_scheduled = true
+   end
+end
+
+
+
+
+
+
+function download_cache.find(url)
+   local store = store_dir()
+   if not store or not fs.exists(store) or not is_cacheable(url) then
+      return nil
+   end
+   local idx = get_index(store)
+   local name = name_of(url)
+   local digest = idx.urls[url] or (name and idx.names[name])
+   if not digest then
+      return nil
+   end
+   local pathname = object_path(store, digest)
+   if not fs.exists(pathname) then
+      return nil
+   end
+   if fs.get_sha256(pathname) ~= digest then
+      os.remove(pathname)
+      return nil
+   end
+   record_use(digest, url, file_size(pathname))
+   return pathname
+end
+
+
+
+
+
+
+
+function download_cache.store(url, file, move)
+   local store = store_dir()
+   if not store then
+      return nil, "download cache is disabled"
+   elseif not is_cacheable(url) then
+      return nil, "development versions are not cached"
+   end
+   local digest, err = fs.get_sha256(file)
+   if not digest then
+      return nil, err
+   end
+   local pathname = object_path(store, digest)
+   local ok
+   ok, err = fs.make_dir(dir.dir_name(pathname))
+   if not ok then
+      return nil, err
+   end
+   if not fs.exists(pathname) then
+
+
+      local staging_dir = dir.path(store, "tmp")
+      fs.make_dir(staging_dir)
+      local staging
+      staging, err = fs.make_temp_dir("download", staging_dir)
+      if staging then
+         local partial = dir.path(staging, digest)
+         ok, err = fs.copy(file, partial)
+         ok = ok and os.rename(partial, pathname)
+         fs.delete(staging)
+      else
+         ok = false
+      end
+      if not ok then
+         return nil, "Failed storing " .. url .. " in the download cache" .. (err and ": " .. err or "")
+      end
+   end
+   if move then
+      os.remove(file)
+   end
+   get_index(store)
+   record_use(digest, url, file_size(pathname))
+   save_index(store)
+   return pathname
+end
+
+
+
+
+function download_cache.stats()
+   local stats = { files = 0, size = 0, urls = 0 }
+   local store = store_dir()
+   if not store or not fs.exists(store) then
+      return stats
+   end
+   local idx = load_index(store)
+   for digest, obj in pairs(idx.objects) do
+      if fs.exists(object_path(store, digest)) then
+         stats.files = stats.files + 1
+         stats.size = stats.size + obj.size
+      end
+   end
+   for _ in pairs(idx.urls) do
+      stats.urls = stats.urls + 1
+   end
+   return stats
+end
+
+
+
+
+
+
+function download_cache.prune(max_bytes)
+   local store = store_dir()
+   if not store or not fs.exists(store) then
+      return 0, 0
+   end
+   local removed, total = save_index(store, max_bytes)
+   if not removed then
+      return nil, total
+   end
+   local objects_dir = dir.path(store, "objects")
+   for _, subdir in ipairs(fs.list_dir(objects_dir)) do
+      for _, file in ipairs(fs.list_dir(dir.path(objects_dir, subdir))) do
+         if not index.objects[file] then
+            os.remove(dir.path(objects_dir, subdir, file))
+            removed = removed + 1
+         end
+      end
+      fs.remove_dir_if_empty(dir.path(objects_dir, subdir))
+   end
+   return removed, total
+end
+
+
+
+
+function download_cache.verify()
+   local bad = {}
+   local store = store_dir()
+   if not store or not fs.exists(store) then
+      return bad
+   end
+   local pathnames = {}
+   local files = {}
+   for digest in util.sortedpairs(load_index(store).objects) do
+      local pathname = object_path(store, digest)
+      if fs.exists(pathname) then
+         pathnames[digest] = pathname
+         table.insert(files, pathname)
+      end
+   end
+   local computed, err = fs.get_checksums(files, "sha256")
+   if not computed then
+      return nil, "Failed checking the download cache: " .. tostring(err)
+   end
+   for digest, pathname in util.sortedpairs(pathnames) do
+      if computed[pathname] ~= digest then
+         os.remove(pathname)
+         table.insert(bad, digest)
+      end
+   end
+   if #bad > 0 then
+      save_index(store)
+   end
+   return bad
+end
+
+
+
+
+function download_cache.clear()
+   index, pending = nil, nil
+   local store = store_dir()
+   if not store or not fs.exists(store) then
+      return true
+   end
+   local lock, err = fs.lock_access(store)
+   if not lock then
+      return nil, "Failed locking download cache: " .. tostring(err)
+   end
+   fs.delete(dir.path(store, "objects"))
+   os.remove(dir.path(store, "index"))
+   fs.unlock_access(lock)
+   return true
+end
+
+return download_cache
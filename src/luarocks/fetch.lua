@@ -1,4 +1,4 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local assert = _tl_compat and _tl_compat.assert or assert; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local pcall = _tl_compat and _tl_compat.pcall or pcall; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local assert = _tl_compat and _tl_compat.assert or assert; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local pcall = _tl_compat and _tl_compat.pcall or pcall; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local _tl_table_unpack = unpack or table.unpack; local type = type
 
 local fetch = { Fetch = {} }
 
@@ -15,6 +15,8 @@ local fetch = { Fetch = {} }
 
 
 
+
+
 local fs = require("luarocks.fs")
 local dir = require("luarocks.dir")
 local rockspecs = require("luarocks.rockspecs")
@@ -22,12 +24,46 @@ local signing = require("luarocks.signing")
 local persist = require("luarocks.persist")
 local util = require("luarocks.util")
 local cfg = require("luarocks.core.cfg")
+local download_cache = require("luarocks.download_cache")
 
 
 
 
 
 
+local prefetched = {}
+
+
+
+
+
+local function cache_location(url)
+   local repo_url, filename = url:match("^(.*)/([^/]+)$")
+   local name = repo_url:gsub("[/:]", "_")
+   return name, filename
+end
+
+
+
+
+
+function fetch.cache_pathname(url)
+   local name, filename = cache_location(url)
+   return dir.path(cfg.local_cache, name, filename)
+end
+
+
+
+
+
+
+
+local function is_cache_fresh(name, cachefile)
+   local checkfile = cachefile .. ".check"
+   return (fs.exists(checkfile) and fs.file_age(checkfile) < 10 or
+      cfg.aggressive_cache and (not name:match("^manifest"))) and fs.exists(cachefile)
+end
+
 
 
 
@@ -46,8 +82,7 @@ local cfg = require("luarocks.core.cfg")
 
 
 function fetch.fetch_caching(url, mirroring)
-   local repo_url, filename = url:match("^(.*)/([^/]+)$")
-   local name = repo_url:gsub("[/:]", "_")
+   local name, filename = cache_location(url)
    local cache_dir = dir.path(cfg.local_cache, name)
    local ok = fs.exists(cfg.local_cache)
    if ok then
@@ -57,9 +92,12 @@ function fetch.fetch_caching(url, mirroring)
    local cachefile = dir.path(cache_dir, filename)
    local checkfile = cachefile .. ".check"
 
-   if (fs.exists(checkfile) and fs.file_age(checkfile) < 10 or
-      cfg.aggressive_cache and (not name:match("^manifest"))) and fs.exists(cachefile) then
+   local prefetched_file = prefetched[url]
+   if prefetched_file and fs.exists(prefetched_file) then
+      return prefetched_file, nil, nil, true
+   end
 
+   if is_cache_fresh(name, cachefile) then
       return cachefile, nil, nil, true
    end
 
@@ -105,6 +143,79 @@ function fetch.fetch_caching(url, mirroring)
    return file, nil, nil, from_cache
 end
 
+
+
+
+
+
+
+
+
+function fetch.prefetch(urls)
+   local jobs = cfg.download_jobs or 1
+   if jobs < 2 or not fs.exists(cfg.local_cache) then
+      return
+   end
+
+   local downloads = {}
+   local queued = {}
+   local locked = {}
+   local locks = {}
+   for _, url in ipairs(urls) do
+      local protocol = dir.split_url(url)
+      if protocol ~= "file" and dir.is_basic_protocol(protocol) and not (queued[url] or prefetched[url] or download_cache.find(url)) then
+         local name, filename = cache_location(url)
+         local cache_dir = dir.path(cfg.local_cache, name)
+         local cachefile = dir.path(cache_dir, filename)
+         if is_cache_fresh(name, cachefile) then
+            prefetched[url] = cachefile
+         else
+            if locked[cache_dir] == nil then
+               local lock
+               if fs.make_dir(cache_dir) then
+                  lock = fs.lock_access(cache_dir)
+               end
+               if lock then
+                  table.insert(locks, lock)
+               end
+               locked[cache_dir] = lock ~= nil
+            end
+            if locked[cache_dir] then
+               queued[url] = true
+               table.insert(downloads, { url = url, filename = cachefile })
+            end
+         end
+      end
+   end
+
+   if #downloads > 0 then
+      util.printout("Downloading " .. #downloads .. " files, " .. math.min(jobs, #downloads) .. " at a time...")
+      local failed = fs.download_parallel(downloads, jobs, function(url, ok, err)
+         if ok then
+            util.printout("Fetched " .. url)
+         else
+            util.warning(err .. " - it will be retried when needed")
+         end
+      end)
+      if failed then
+         for _, d in ipairs(downloads) do
+            if not failed[d.url] then
+               local fd = io.open(d.filename .. ".check", "wb")
+               if fd then
+                  fd:write("!")
+                  fd:close()
+               end
+               prefetched[d.url] = d.filename
+            end
+         end
+      end
+   end
+
+   for _, lock in ipairs(locks) do
+      fs.unlock_access(lock)
+   end
+end
+
 local function ensure_trailing_slash(url)
    return (url:gsub("/*$", "/"))
 end
@@ -243,9 +354,20 @@ function fetch.fetch_url_at_temp_dir(url, tmpname, filename, cache)
 
       local file, err, errcode
 
-      if cache then
-         local cachefile
-         cachefile, err, errcode = fetch.fetch_caching(url)
+      if cache or prefetched[url] then
+         local cachefile = cache and download_cache.find(url)
+         if not cachefile then
+            cachefile, err, errcode = fetch.fetch_caching(url)
+
+
+            if cachefile and cache then
+               local stored = download_cache.store(url, cachefile, true)
+               if stored then
+                  os.remove(cachefile .. ".check")
+                  cachefile = stored
+               end
+            end
+         end
 
          if cachefile then
             file = dir.path(temp_dir, filename)
@@ -344,7 +466,9 @@ end
 
 
 
-function fetch.fetch_and_unpack_rock(url, dest, verify)
+
+
+function fetch.fetch_and_unpack_rock(url, dest, verify, files)
 
    local name = dir.base_name(url):match("(.*)%.[^.]*%.rock")
    local tmpname = "luarocks-rock-" .. name
@@ -382,7 +506,12 @@ function fetch.fetch_and_unpack_rock(url, dest, verify)
    end
    local ok, errchange = fs.change_dir(unpack_dir)
    if not ok then return nil, errchange end
-   ok, err = fs.unzip(rock_file)
+   if files then
+
+      fs.unzip(rock_file, _tl_table_unpack(files))
+   else
+      ok, err = fs.unzip(rock_file)
+   end
    if not ok then
       return nil, "Failed unpacking rock file: " .. rock_file .. ": " .. err
    end
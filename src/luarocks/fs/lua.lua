@@ -300,8 +300,8 @@ function fs_lua.system_temp_dir()
    return os.getenv("TMPDIR") or os.getenv("TEMP") or "/tmp"
 end
 
-local function temp_dir_pattern(name_pattern)
-   return dir.path(fs.system_temp_dir(),
+local function temp_dir_pattern(name_pattern, where)
+   return dir.path(where or fs.system_temp_dir(),
                    "luarocks_" .. dir.normalize(name_pattern):gsub("[/\\]", "_") .. "-")
 end
 
@@ -703,6 +703,27 @@ function fs_lua.set_time(file, time)
    return lfs.touch(file, time)
 end
 
+--- Create a hard link.
+-- @param src string: Pathname of the existing file.
+-- @param dest string: Pathname of the link to create.
+-- @return boolean or (nil, string): true on success, or nil and an
+-- error message.
+function fs_lua.link(src, dest)
+   assert(src and dest)
+   local ok, err = lfs.link(dir.normalize(src), dir.normalize(dest))
+   if not ok then
+      return nil, "Failed linking "..src.." to "..dest..": "..tostring(err)
+   end
+   return true
+end
+
+--- Get the number of hard links to a file.
+-- @param file string: pathname of the file.
+-- @return integer or nil: the number of links, or nil if it is unknown.
+function fs_lua.link_count(file)
+   return lfs.attributes(dir.normalize(file), "nlink")
+end
+
 else -- if not lfs_ok
 
 function fs_lua.exists(file)
@@ -721,6 +742,8 @@ end
 -- lua-bz2 functions
 ---------------------------------------------------------------------
 
+local bunzip2_chunks
+
 if bz2_ok then
 
 local function bunzip2_string(data)
@@ -748,6 +771,30 @@ function fs_lua.bunzip2(infile, outfile)
    return fs.filter_file(bunzip2_string, infile, outfile)
 end
 
+function bunzip2_chunks(infile)
+   local fd, err = io.open(infile, "rb")
+   if not fd then
+      return nil, err
+   end
+   local decompressor = bz2.initDecompress()
+   return function()
+      local data = fd and fd:read(65536)
+      if not data then
+         if fd then
+            fd:close()
+            fd = nil
+            decompressor:close()
+         end
+         return nil
+      end
+      local output, err = decompressor:update(data)
+      if not output then
+         error(err, 0)
+      end
+      return output
+   end
+end
+
 end
 
 ---------------------------------------------------------------------
@@ -760,8 +807,8 @@ function fs_lua.zip(zipfile, ...)
    return zip.zip(zipfile, ...)
 end
 
-function fs_lua.unzip(zipfile)
-   return zip.unzip(zipfile)
+function fs_lua.unzip(zipfile, ...)
+   return zip.unzip(zipfile, ...)
 end
 
 function fs_lua.gunzip(infile, outfile)
@@ -789,7 +836,128 @@ local redirect_protocols = {
    https = luasec_ok and https,
 }
 
-local function request(url, method, http, loop_control)  -- luacheck: ignore 431
+local socket = require("socket")
+local socket_http = http
+local ssl = luasec_ok and require("ssl")
+
+-- Same defaults as LuaSec's https.request.
+local tls_params = {
+   mode = "client",
+   protocol = "any",
+   options = { "all", "no_sslv2", "no_sslv3", "no_tlsv1" },
+   verify = "none",
+}
+
+-- Idle HTTP/1.1 connections, kept open after a request and reused by the
+-- next requests to the same server, so that fetching many files does not
+-- cost a TCP (and TLS) handshake each. Maps "scheme://host:port" to an
+-- array of { sock = socket, since = time }.
+local idle_connections = {}
+local max_idle_per_server = 2
+-- Servers usually drop idle connections after a few seconds.
+local max_idle_time = 5
+
+local function take_idle_connection(key)
+   local list = idle_connections[key]
+   local now = socket.gettime()
+   while list and #list > 0 do
+      local idle = table.remove(list)
+      if now - idle.since < max_idle_time then
+         return idle.sock
+      end
+      idle.sock:close()
+   end
+end
+
+local function drop_idle_connections(key)
+   for _, idle in ipairs(idle_connections[key] or {}) do
+      idle.sock:close()
+   end
+   idle_connections[key] = nil
+end
+
+local function release_connection(conn, reusable)
+   if not conn.sock then
+      return
+   end
+   local list = idle_connections[conn.key] or {}
+   if reusable and conn.key and #list < max_idle_per_server then
+      table.insert(list, { sock = conn.sock, since = socket.gettime() })
+      idle_connections[conn.key] = list
+   else
+      conn.sock:close()
+   end
+   conn.sock = nil
+end
+
+--- Create the socket object used by LuaSocket's http.request for one
+-- request. It connects through an idle connection to the same server if
+-- there is one, and it leaves the connection open when LuaSocket closes
+-- it, so that release_connection can decide whether to keep it.
+local function pooled_connection(conn)
+   local c = {}
+   function c:settimeout(timeout)
+      conn.timeout = timeout
+      return 1
+   end
+   function c:connect(host, port)
+      conn.key = conn.scheme .. "://" .. host .. ":" .. tostring(port)
+      conn.sock = take_idle_connection(conn.key)
+      if conn.sock then
+         conn.reused = true
+         conn.sock:settimeout(conn.timeout)
+         return 1
+      end
+      local sock, err = socket.tcp()
+      if not sock then
+         return nil, err
+      end
+      conn.sock = sock
+      sock:settimeout(conn.timeout)
+      local ok, errconnect = sock:connect(host, port)
+      if not ok then
+         return nil, errconnect
+      end
+      if conn.scheme == "https" then
+         local tls, errwrap = ssl.wrap(sock, tls_params)
+         if not tls then
+            return nil, errwrap
+         end
+         conn.sock = tls
+         tls:sni(host)
+         tls:settimeout(conn.timeout)
+         local okshake, errshake = tls:dohandshake()
+         if not okshake then
+            return nil, errshake
+         end
+      end
+      return 1
+   end
+   function c:send(...) return conn.sock:send(...) end
+   function c:receive(...) return conn.sock:receive(...) end
+   function c:getfd() return conn.sock:getfd() end
+   function c:dirty() return conn.sock:dirty() end
+   function c:close() return 1 end
+   return c
+end
+
+--- Check whether a connection can carry another request once a response
+-- has been received from it.
+local function can_reuse_connection(method, code, headers, status)
+   local connection = (headers.connection or ""):lower()
+   if connection:match("close") then
+      return false
+   elseif (status or ""):match("^HTTP/1%.0") and not connection:match("keep%-alive") then
+      return false
+   elseif method == "HEAD" or code == 204 or code == 304 then
+      return true
+   end
+   -- otherwise the body was only delimited by the server closing it
+   return headers["content-length"] ~= nil
+      or (headers["transfer-encoding"] or ""):lower():match("chunked") ~= nil
+end
+
+local function request(url, method, http, req_headers, loop_control)  -- luacheck: ignore 431
    local result = {}
 
    if cfg.verbose then
@@ -810,7 +978,7 @@ local function request(url, method, http, loop_control)  -- luacheck: ignore 431
    if cfg.connection_timeout and cfg.connection_timeout > 0 then
       http.TIMEOUT = cfg.connection_timeout
    end
-   local res, status, headers, err = http.request {
+   local req = {
       url = url,
       proxy = proxy,
       method = method,
@@ -830,6 +998,36 @@ local function request(url, method, http, loop_control)  -- luacheck: ignore 431
          ["user-agent"] = cfg.user_agent.." via LuaSocket"
       },
    }
+   for name, value in pairs(req_headers or {}) do
+      req.headers[name] = value
+   end
+   local res, status, headers, err
+   if proxy and http ~= socket_http then
+      -- let LuaSec report that it does not support proxies
+      res, status, headers, err = http.request(req)
+   else
+      -- HTTPS connections are made by pooled_connection, so both schemes
+      -- go through LuaSocket's client
+      local conn = { scheme = (http == socket_http) and "http" or "https" }
+      req.create = function() return pooled_connection(conn) end
+      req.headers.connection = "keep-alive"
+      if conn.scheme == "https" then
+         -- socket.http defaults to port 80 for URLs without a port
+         req.port = tonumber(url:match("^https://[^/]-:(%d+)")) or 443
+         socket_http.TIMEOUT = http.TIMEOUT
+      end
+      res, status, headers, err = socket_http.request(req)
+      release_connection(conn, res and can_reuse_connection(method, status, headers, err))
+      if not res and conn.reused then
+         -- the server closed the idle connection: retry on a new one
+         drop_idle_connections(conn.key)
+         result = {}
+         req.sink = ltn12.sink.table(result)
+         conn = { scheme = conn.scheme }
+         res, status, headers, err = socket_http.request(req)
+         release_connection(conn, res and can_reuse_connection(method, status, headers, err))
+      end
+   end
    if cfg.show_downloads then
       io.write("\n")
    end
@@ -846,13 +1044,13 @@ local function request(url, method, http, loop_control)  -- luacheck: ignore 431
                return nil, "Redirection loop -- broken URL?"
             end
             loop_control[url] = true
-            return request(location, method, redirect_protocols[protocol], loop_control)
+            return request(location, method, redirect_protocols[protocol], req_headers, loop_control)
          else
             return nil, "URL redirected to unsupported protocol - install luasec >= 1.1 to get HTTPS support.", "https"
          end
       end
       return nil, err
-   elseif status ~= 200 then
+   elseif status ~= 200 and status ~= 304 then
       return nil, err
    else
       return result, status, headers, err
@@ -882,51 +1080,65 @@ local function fail_with_status(filename, status, headers)
    return nil, status, headers
 end
 
+--- Save the validators of a downloaded file, to revalidate it later.
+-- @param filename string: the downloaded file.
+-- @param headers table: the response headers.
+-- @param not_modified boolean: whether the server answered that the file
+-- did not change, in which case validators missing from the response are
+-- kept.
+local function write_validators(filename, headers, not_modified)
+   for sidecar, header in pairs({ etag = "etag", timestamp = "last-modified" }) do
+      if headers[header] then
+         write_timestamp(filename .. "." .. sidecar, headers[header])
+      elseif not not_modified then
+         os.remove(filename .. "." .. sidecar)
+      end
+   end
+   write_timestamp(filename .. ".unixtime", os.time())
+end
+
 -- @param url string: URL to fetch.
 -- @param filename string: local filename of the file to fetch.
 -- @param http table: The library to use (http from LuaSocket or LuaSec)
--- @param cache boolean: Whether to use a `.timestamp` file to check
--- via the HTTP Last-Modified header if the full download is needed.
+-- @param cache boolean: Whether to send the ETag and Last-Modified
+-- validators saved by the previous download, so that the file is only
+-- transferred again if it changed.
 -- @return (boolean | (nil, string, string?)): True if successful, or
 -- nil, error message and optionally HTTPS error in case of errors.
 local function http_request(url, filename, http, cache)  -- luacheck: ignore 431
+   local req_headers
    if cache then
       local status = read_timestamp(filename..".status")
       local timestamp = read_timestamp(filename..".timestamp")
-      if status or timestamp then
+      local etag = read_timestamp(filename..".etag")
+      if status then
          local unixtime = read_timestamp(filename..".unixtime")
-         if tonumber(unixtime) then
-            local diff = os.time() - tonumber(unixtime)
-            if status then
-               if diff < cfg.cache_fail_timeout then
-                  return nil, status, {}
-               end
-            else
-               if diff < cfg.cache_timeout then
-                  return true, nil, nil, true
-               end
-            end
-         end
-
-         local result, status, headers, err = request(url, "HEAD", http)  -- luacheck: ignore 421
-         if not result then
-            return fail_with_status(filename, status, headers)
+         if tonumber(unixtime) and os.time() - tonumber(unixtime) < cfg.cache_fail_timeout then
+            return nil, status, {}
          end
-         if status == 200 and headers["last-modified"] == timestamp then
-            write_timestamp(filename .. ".unixtime", os.time())
+      elseif (timestamp or etag) and fs.exists(filename) then
+         local unixtime = read_timestamp(filename..".unixtime")
+         if tonumber(unixtime) and os.time() - tonumber(unixtime) < cfg.cache_timeout then
             return true, nil, nil, true
          end
+         req_headers = {
+            ["if-none-match"] = etag,
+            ["if-modified-since"] = timestamp,
+         }
       end
    end
-   local result, status, headers, err = request(url, "GET", http)
+   local result, status, headers, err = request(url, "GET", http, req_headers)
    if not result then
       if status then
          return fail_with_status(filename, status, headers)
       end
    end
-   if cache and headers["last-modified"] then
-      write_timestamp(filename .. ".timestamp", headers["last-modified"])
-      write_timestamp(filename .. ".unixtime", os.time())
+   if cache then
+      os.remove(filename..".status")
+      write_validators(filename, headers, status == 304)
+      if status == 304 then
+         return true, nil, nil, true
+      end
    end
    local file = io.open(filename, "wb")
    if not file then return nil, 0, {} end
@@ -1046,6 +1258,56 @@ function fs_lua.get_md5(file)
    return nil, "Failed to compute MD5 hash for file "..file
 end
 
+local hash_buffer_size = 1024 * 1024
+
+--- Get the MD5 checksum for a file, feeding it to the md5 module in
+-- large blocks if the module supports incremental hashing (lmd5 and
+-- the pure-Lua md5.lua do).
+local function md5_stream(file)
+   local ctx = md5.new and md5.new()
+   if not (type(ctx) == "table" or type(ctx) == "userdata") or not ctx.update then
+      return fs.get_md5(file)
+   end
+   local fd = io.open(file, "rb")
+   if not fd then return nil, "Failed to open file for reading: "..file end
+   while true do
+      local block = fd:read(hash_buffer_size)
+      if not block then break end
+      ctx:update(block)
+   end
+   fd:close()
+   local computed
+   if ctx.digest then
+      computed = ctx:digest()
+   elseif ctx.finish and md5.tohex then
+      computed = md5.tohex(ctx:finish())
+   end
+   if computed then return computed end
+   return fs.get_md5(file)
+end
+
+--- Get the checksums of several files.
+-- MD5 checksums are computed in-process; other algorithms use the
+-- external tools, which are run once for a batch of files.
+-- @param files table: the files to be computed.
+-- @param algorithm string: "md5" (the default) or "sha256".
+-- @return table or (nil, string): a table mapping each file to its
+-- checksum, or nil and an error message.
+function fs_lua.get_checksums(files, algorithm)
+   if algorithm and algorithm ~= "md5" then
+      return require("luarocks.fs.tools").get_checksums(files, algorithm)
+   end
+   local result = {}
+   for _, file in ipairs(files) do
+      local computed, err = md5_stream(fs.absolute_name(file))
+      if not computed then
+         return nil, err
+      end
+      result[file] = computed
+   end
+   return result
+end
+
 end
 end
 
@@ -1108,6 +1370,15 @@ function fs_lua.set_permissions(filename, mode, scope)
    return err == 0
 end
 
+function fs_lua.set_permissions_many(filenames, mode, scope)
+   for _, filename in ipairs(filenames) do
+      if not fs.set_permissions(filename, mode, scope) then
+         return false, "Failed setting permissions of "..filename
+      end
+   end
+   return true
+end
+
 function fs_lua.current_user()
    return posix.getpwuid(posix.geteuid()).pw_name
 end
@@ -1122,11 +1393,13 @@ if posix.mkdtemp then
 --- Create a temporary directory.
 -- @param name_pattern string: name pattern to use for avoiding conflicts
 -- when creating temporary directory.
+-- @param where string or nil: the directory to create it in, instead of
+-- the system temporary directory.
 -- @return string or (nil, string): name of temporary directory or (nil, error message) on failure.
-function fs_lua.make_temp_dir(name_pattern)
+function fs_lua.make_temp_dir(name_pattern, where)
    assert(type(name_pattern) == "string")
 
-   return posix.mkdtemp(temp_dir_pattern(name_pattern) .. "-XXXXXX")
+   return posix.mkdtemp(temp_dir_pattern(name_pattern, where) .. "-XXXXXX")
 end
 
 end -- if posix.mkdtemp
@@ -1139,19 +1412,21 @@ end
 
 if not fs_lua.make_temp_dir then
 
-function fs_lua.make_temp_dir(name_pattern)
+function fs_lua.make_temp_dir(name_pattern, where)
    assert(type(name_pattern) == "string")
 
    local ok, err
    for _ = 1, 3 do
-      local name = temp_dir_pattern(name_pattern) .. tostring(math.random(10000000))
-      ok, err = fs.make_dir(name)
-      if ok then
-         return name
+      local name = temp_dir_pattern(name_pattern, where) .. tostring(math.random(10000000))
+      if not fs.exists(name) then
+         ok, err = fs.make_dir(name)
+         if ok then
+            return name
+         end
       end
    end
 
-   return nil, err
+   return nil, err or "Could not create a temporary directory"
 end
 
 end
@@ -1285,9 +1560,24 @@ function fs_lua.is_lua(filename)
   return (result == true)
 end
 
+--- Get the uncompressed contents of a compressed tarball in chunks,
+-- if the needed decompression library is available.
+-- @param archive string: Filename of archive.
+-- @return function or nil: a function returning the next chunk of the
+-- .tar archive, or nil at its end.
+local function tarball_chunks(archive)
+   if zip_ok and (archive:match("%.tar%.gz$") or archive:match("%.tgz$")) then
+      return zip.gunzip_chunks(archive)
+   elseif bz2_ok and archive:match("%.tar%.bz2$") then
+      return bunzip2_chunks(archive)
+   end
+end
+
 --- Unpack an archive.
 -- Extract the contents of an archive, detecting its format by
 -- filename extension.
+-- Compressed tarballs are decompressed and unpacked in a single pass
+-- when possible, without writing the intermediate .tar file.
 -- @param archive string: Filename of archive.
 -- @return boolean or (boolean, string): true on success, false and an error message on failure.
 function fs_lua.unpack_archive(archive)
@@ -1295,7 +1585,14 @@ function fs_lua.unpack_archive(archive)
 
    local ok, err
    archive = fs.absolute_name(archive)
-   if archive:match("%.tar%.gz$") then
+   local chunks = tarball_chunks(archive)
+   if chunks then
+      local pok
+      pok, ok, err = pcall(tar.untar_stream, chunks, ".")
+      if not pok then
+         ok, err = false, tostring(ok)
+      end
+   elseif archive:match("%.tar%.gz$") then
       local tar_filename = archive:gsub("%.gz$", "")
       ok, err = fs.gunzip(archive, tar_filename)
       if ok then
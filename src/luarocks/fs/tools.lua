@@ -30,6 +30,12 @@ do
          { var = "OPENSSL", name = "openssl", cmdarg = "md5" },
          { var = "MD5", name = "md5" },
       },
+      sha256checker = {
+         desc = "SHA-256 checker",
+         { var = "SHA256SUM", name = "sha256sum" },
+         { var = "SHASUM", name = "shasum", cmdarg = "-a 256" },
+         { var = "OPENSSL", name = "openssl", cmdarg = "sha256" },
+      },
    }
 
    local function is_available(opt)
@@ -155,15 +161,135 @@ function tools.dir_iterator(at)
    pipe:close()
 end
 
+local function wget_command()
+   local wget_cmd = vars.WGET.." "..vars.WGETNOCERTFLAG.." --no-cache --user-agent=\""..cfg.user_agent.." via wget\" --quiet "
+   if cfg.connection_timeout and cfg.connection_timeout > 0 then
+     wget_cmd = wget_cmd .. "--timeout="..tostring(cfg.connection_timeout).." --tries=1 "
+   end
+   return wget_cmd
+end
+
+local function curl_command()
+   local curl_cmd = vars.CURL.." "..vars.CURLNOCERTFLAG.." -f -L --user-agent \""..cfg.user_agent.." via curl\" "
+   if cfg.connection_timeout and cfg.connection_timeout > 0 then
+     curl_cmd = curl_cmd .. "--connect-timeout "..tostring(cfg.connection_timeout).." "
+   end
+   return curl_cmd
+end
+
+local function read_sidecar(filename)
+   local fd = io.open(filename, "r")
+   if fd then
+      local data = fd:read("*a")
+      fd:close()
+      return data
+   end
+end
+
+local function write_sidecar(filename, data)
+   local fd = io.open(filename, "w")
+   if fd then
+      fd:write(data)
+      fd:close()
+   end
+end
+
+--- Get the headers making a request conditional on a cached file
+-- having changed, from the validators saved when it was downloaded.
+-- @param filename string: the cached file.
+-- @return table: an array of header lines, possibly empty.
+local function conditional_headers(filename)
+   local headers = {}
+   if fs.exists(filename) then
+      local etag = read_sidecar(filename .. ".etag")
+      if etag then
+         table.insert(headers, "If-None-Match: " .. etag)
+      end
+      local timestamp = read_sidecar(filename .. ".timestamp")
+      if timestamp then
+         table.insert(headers, "If-Modified-Since: " .. timestamp)
+      end
+   end
+   return headers
+end
+
+--- Parse the response headers dumped by curl or wget.
+-- When redirections were followed, only the last response is kept.
+-- @param filename string: the file the headers were written to.
+-- @return (number, table): the status code, or nil if none was found,
+-- and the headers, with lowercase names.
+local function read_response_headers(filename)
+   local status, headers
+   local fd = io.open(filename, "r")
+   if not fd then
+      return nil, {}
+   end
+   for line in fd:lines() do
+      line = line:gsub("\r$", "")
+      local code = line:match("^%s*HTTP/[%d.]+%s+(%d+)")
+      if code then
+         status, headers = tonumber(code), {}
+      elseif headers then
+         local name, value = line:match("^%s*([%w-]+):%s*(.-)%s*$")
+         if name then
+            headers[name:lower()] = value
+         end
+      end
+   end
+   fd:close()
+   return status, headers or {}
+end
+
+--- Keep a conditionally downloaded file and its validators.
+-- @param filename string: the cached file.
+-- @param temp_file string: the file the response body was written to.
+-- @param headers_file string: the file the response headers were written to.
+-- @param ok boolean: whether the downloader reported success.
+-- If the server answered with an error, the status is saved, so that
+-- the file is not requested again for `cache_fail_timeout` seconds.
+-- @return (boolean, boolean): whether the cached file is up to date, and
+-- whether it was kept as is because the server answered "304 Not Modified".
+local function finish_conditional_download(filename, temp_file, headers_file, ok)
+   local status, headers = read_response_headers(headers_file)
+   os.remove(headers_file)
+   local not_modified = status == 304 and fs.exists(filename)
+   if not_modified then
+      ok = true
+   elseif ok then
+      os.remove(filename)
+      ok = os.rename(temp_file, filename)
+   end
+   os.remove(temp_file)
+   if not ok and status then
+      write_sidecar(filename .. ".unixtime", os.time())
+      write_sidecar(filename .. ".status", status)
+   end
+   if ok then
+      os.remove(filename .. ".status")
+      for sidecar, header in pairs({ etag = "etag", timestamp = "last-modified" }) do
+         if headers[header] then
+            write_sidecar(filename .. "." .. sidecar, headers[header])
+         elseif not not_modified then
+            os.remove(filename .. "." .. sidecar)
+         end
+      end
+      write_sidecar(filename .. ".unixtime", os.time())
+   end
+   return ok, not_modified
+end
+
 --- Download a remote file.
 -- @param url string: URL to be fetched.
 -- @param filename string or nil: this function attempts to detect the
 -- resulting local filename of the remote file as the basename of the URL;
 -- if that is not correct (due to a redirection, for example), the local
 -- filename can be given explicitly as this second argument.
--- @param cache boolean: compare remote timestamps via HTTP HEAD prior to
--- re-downloading the file.
--- @return (string, string, string): filename on success,
+-- @param cache boolean: send the ETag and Last-Modified validators saved
+-- by the previous download of the file, so that the server only sends it
+-- again if it changed. A file the server failed to send is not requested
+-- again for `cache_fail_timeout` seconds.
+-- @return (string, string, string, boolean): filename, nil, nil and
+-- true if the file was kept from the cache on success,
 -- false and the error message and code on failure.
 function tools.use_downloader(url, filename, cache)
    assert(type(url) == "string")
@@ -171,47 +297,157 @@ function tools.use_downloader(url, filename, cache)
 
    filename = fs.absolute_name(filename or dir.base_name(url))
 
+   if cache then
+      local status = read_sidecar(filename .. ".status")
+      local unixtime = read_sidecar(filename .. ".unixtime")
+      if status and tonumber(unixtime) and os.time() - tonumber(unixtime) < cfg.cache_fail_timeout then
+         return nil, "failed downloading " .. url .. " - " .. status, "network"
+      end
+   end
+
    local downloader, err = fs.which_tool("downloader")
    if not downloader then
       return nil, err, "downloader"
    end
 
    local ok = false
+   local from_cache
+   local temp_file = filename .. ".tmp"
+   local headers_file = filename .. ".headers"
    if downloader == "wget" then
-      local wget_cmd = vars.WGET.." "..vars.WGETNOCERTFLAG.." --no-cache --user-agent=\""..cfg.user_agent.." via wget\" --quiet "
-      if cfg.connection_timeout and cfg.connection_timeout > 0 then
-        wget_cmd = wget_cmd .. "--timeout="..tostring(cfg.connection_timeout).." --tries=1 "
-      end
+      local wget_cmd = wget_command()
       if cache then
-         -- --timestamping is incompatible with --output-document,
-         -- but that's not a problem for our use cases.
-         fs.delete(filename .. ".unixtime")
-         fs.change_dir(dir.dir_name(filename))
-         ok = fs.execute_quiet(wget_cmd.." --timestamping ", url)
-         fs.pop_dir()
+         for _, header in ipairs(conditional_headers(filename)) do
+            wget_cmd = wget_cmd .. "--header " .. fs.Q(header) .. " "
+         end
+         -- wget fails on "304 Not Modified", so the status is read
+         -- from the server response it prints
+         ok = fs.execute_string(wget_cmd.."--server-response --output-document "..fs.Q(temp_file).." "..fs.Q(url).." 2> "..fs.Q(headers_file))
+         ok, from_cache = finish_conditional_download(filename, temp_file, headers_file, ok)
       elseif filename then
          ok = fs.execute_quiet(wget_cmd.." --output-document ", filename, url)
       else
          ok = fs.execute_quiet(wget_cmd, url)
       end
    elseif downloader == "curl" then
-      local curl_cmd = vars.CURL.." "..vars.CURLNOCERTFLAG.." -f -L --user-agent \""..cfg.user_agent.." via curl\" "
-      if cfg.connection_timeout and cfg.connection_timeout > 0 then
-        curl_cmd = curl_cmd .. "--connect-timeout "..tostring(cfg.connection_timeout).." "
-      end
+      local curl_cmd = curl_command()
       if cache then
-         curl_cmd = curl_cmd .. " -R -z \"" .. filename .. "\" "
+         for _, header in ipairs(conditional_headers(filename)) do
+            curl_cmd = curl_cmd .. "-H " .. fs.Q(header) .. " "
+         end
+         curl_cmd = curl_cmd .. "-D " .. fs.Q(headers_file) .. " "
+         ok = fs.execute_string(fs.quiet_stderr(curl_cmd..fs.Q(url).." --output "..fs.Q(temp_file)))
+         ok, from_cache = finish_conditional_download(filename, temp_file, headers_file, ok)
+      else
+         ok = fs.execute_string(fs.quiet_stderr(curl_cmd..fs.Q(url).." --output "..fs.Q(filename)))
       end
-      ok = fs.execute_string(fs.quiet_stderr(curl_cmd..fs.Q(url).." --output "..fs.Q(filename)))
    end
    if ok then
-      return filename
+      return filename, nil, nil, from_cache
    else
       os.remove(filename)
       return nil, "failed downloading " .. url, "network"
    end
 end
 
+--- Run several commands, up to `jobs` of them at the same time.
+-- The output of each command is captured, so that the outputs of
+-- commands running at the same time are not mixed.
+-- @param commands table: an array of command-line strings.
+-- @param jobs number: the maximum number of commands running at once.
+-- @param report function: called as each command finishes, in the
+-- order they were started, with the index of the command, whether it
+-- succeeded and its output. If it returns false, no more commands are
+-- started, and only the ones already running are waited for.
+-- @return boolean: true if all commands were run and succeeded.
+function tools.execute_parallel(commands, jobs, report)
+   assert(type(commands) == "table")
+   assert(type(jobs) == "number")
+   -- a bad build_jobs setting must not keep any job from starting
+   jobs = math.max(1, math.floor(jobs))
+
+   local current, cache_pwd = current_dir_with_cache()
+   if not current then return false end
+
+   local all_ok = true
+   local stopped = false
+   local running = {}
+   local nxt = 1
+   while (not stopped and nxt <= #commands) or #running > 0 do
+      while not stopped and #running < jobs and nxt <= #commands do
+         local cmd = commands[nxt]
+         if current ~= cache_pwd then
+            cmd = fs.command_at(current, cmd)
+         end
+         -- the marker is only printed if the command succeeded
+         local pipe = io.popen(cmd.." 2>&1 && echo luarocks-job-ok")
+         if pipe then
+            table.insert(running, { index = nxt, pipe = pipe })
+         else
+            all_ok = false
+            stopped = (report(nxt, false, "") == false)
+         end
+         nxt = nxt + 1
+      end
+      local job = table.remove(running, 1)
+      if job then
+         local out = job.pipe:read("*a") or ""
+         job.pipe:close()
+         local output, marker = out:match("^(.-)(luarocks%-job%-ok)%s*$")
+         if not marker then
+            output = out
+            all_ok = false
+         end
+         if report(job.index, marker ~= nil, output) == false then
+            stopped = true
+         end
+      end
+   end
+   return all_ok and nxt > #commands
+end
+
+--- Download several remote files, running up to `jobs` downloader
+-- processes at the same time.
+-- @param downloads table: an array of tables with the `url` to be fetched
+-- and the absolute pathname of the local `filename` for each file.
+-- @param jobs number: the maximum number of concurrent transfers.
+-- @param report function or nil: called as each transfer finishes, with
+-- the URL and either true, or false and an error message.
+-- @return table or (nil, string, string): a table mapping the URLs that
+-- failed to their error messages, or nil, an error message and code if
+-- no downloader tool is available.
+function tools.download_parallel(downloads, jobs, report)
+   assert(type(downloads) == "table")
+   assert(type(jobs) == "number")
+
+   local downloader, err = fs.which_tool("downloader")
+   if not downloader then
+      return nil, err, "downloader"
+   end
+
+   local commands = {}
+   for i, d in ipairs(downloads) do
+      if downloader == "wget" then
+         commands[i] = wget_command().." --output-document "..fs.Q(d.filename).." "..fs.Q(d.url)
+      else
+         commands[i] = curl_command()..fs.Q(d.url).." --output "..fs.Q(d.filename)
+      end
+   end
+
+   local failed = {}
+   fs.execute_parallel(commands, jobs, function(i, ok)
+      local d = downloads[i]
+      if not ok then
+         os.remove(d.filename)
+         failed[d.url] = "failed downloading " .. d.url
+      end
+      if report then
+         report(d.url, ok, failed[d.url])
+      end
+   end)
+   return failed
+end
+
 --- Get the MD5 checksum for a file.
 -- @param file string: The file to be computed.
 -- @return string: The MD5 checksum or nil + message
@@ -234,4 +470,144 @@ function tools.get_md5(file)
    end
 end
 
+--- Get the SHA-256 checksum for a file.
+-- @param file string: The file to be computed.
+-- @return string: The SHA-256 checksum or nil + message
+function tools.get_sha256(file)
+   local ok, sha256checker = fs.which_tool("sha256checker")
+   if not ok then
+      return nil, sha256checker
+   end
+
+   local pipe = io.popen(sha256checker.." "..fs.Q(fs.absolute_name(file)))
+   local computed = pipe:read("*l")
+   pipe:close()
+   if computed then
+      -- sha256sum and shasum print the checksum first, openssl prints it last
+      local hex = ("%x"):rep(64)
+      computed = computed:match("^("..hex..")%s") or computed:match("("..hex..")%s*$")
+   end
+   if computed then
+      return computed
+   else
+      return nil, "Failed to compute SHA-256 hash for file "..tostring(fs.absolute_name(file))
+   end
+end
+
+--- Set permissions for several files or directories.
+-- @param filenames table: filenames whose permissions are to be modified
+-- @param mode string ("read" or "exec"): permissions to set
+-- @param scope string ("user" or "all"): the user(s) to whom the permission applies
+-- @return boolean or (boolean, string): true on success, false on failure,
+-- plus an error message
+function tools.set_permissions_many(filenames, mode, scope)
+   for _, filename in ipairs(filenames) do
+      local ok, err = fs.set_permissions(filename, mode, scope)
+      if not ok then
+         return false, err or "Failed setting permissions of "..filename
+      end
+   end
+   return true
+end
+
+--- Create a hard link.
+-- Not supported by the tools of this platform.
+-- @return (nil, string): nil and an error message.
+function tools.link(_, _)
+   return nil, "Hard links are not supported on this platform"
+end
+
+--- Create a reflink, a copy sharing the blocks of the original file.
+-- Not supported by the tools of this platform.
+-- @return (nil, string): nil and an error message.
+function tools.reflink(_, _)
+   return nil, "Reflinks are not supported on this platform"
+end
+
+--- Get the number of hard links to a file.
+-- Not supported by the tools of this platform.
+-- @return nil
+function tools.link_count(_)
+   return nil
+end
+
+local checksum_tools = {
+   md5 = { tool = "md5checker", single = tools.get_md5, len = 32 },
+   sha256 = { tool = "sha256checker", single = tools.get_sha256, len = 64 },
+}
+
+-- Stay well below the command line limits: 8191 characters for cmd.exe,
+-- and 128 KiB for the single argument of "sh -c" on Linux.
+local function max_command_length()
+   return cfg.is_platform("windows") and 8000 or 100000
+end
+
+--- Parse a line printed by a checksum tool for one of several files.
+-- md5sum, sha256sum and shasum print "<sum>  <file>", openssl prints
+-- "MD5(<file>)= <sum>" and BSD md5 prints "MD5 (<file>) = <sum>".
+-- @return (string, string) or nil: the file name and the checksum.
+local function parse_checksum_line(line, len)
+   local sum, file = line:match("^(%x+) [ *](.*)$")
+   if not sum then
+      file, sum = line:match("^[%w%-]+ ?%((.*)%) ?= ?(%x+)$")
+   end
+   if sum and #sum == len then
+      return file, sum:lower()
+   end
+end
+
+--- Get the checksums of several files, running the checksum tool once
+-- for as many files as fit in a command line.
+-- @param files table: the files to be computed.
+-- @param algorithm string: "md5" (the default) or "sha256".
+-- @return table or (nil, string): a table mapping each file to its
+-- checksum, or nil and an error message.
+function tools.get_checksums(files, algorithm)
+   local checksum = checksum_tools[algorithm or "md5"]
+   if not checksum then
+      return nil, "Unsupported checksum algorithm "..tostring(algorithm)
+   end
+   local ok, checker = fs.which_tool(checksum.tool)
+   if not ok then
+      return nil, checker
+   end
+
+   local sums = {}
+   local i = 1
+   while i <= #files do
+      local cmd = { checker }
+      local cmd_len = #checker
+      repeat
+         local arg = fs.Q(fs.absolute_name(files[i]))
+         table.insert(cmd, arg)
+         cmd_len = cmd_len + #arg + 1
+         i = i + 1
+      until i > #files or cmd_len > max_command_length()
+      -- errors are reported by the fallback below
+      local pipe = io.popen(fs.quiet_stderr(table.concat(cmd, " ")))
+      for line in pipe:lines() do
+         local file, sum = parse_checksum_line(line, checksum.len)
+         if file then
+            sums[file] = sum
+         end
+      end
+      pipe:close()
+   end
+
+   local result = {}
+   for _, file in ipairs(files) do
+      local sum = sums[fs.absolute_name(file)]
+      if not sum then
+         -- file names the tool escapes in its output, or an error
+         local err
+         sum, err = checksum.single(file)
+         if not sum then
+            return nil, err
+         end
+      end
+      result[file] = sum
+   end
+   return result
+end
+
 return tools
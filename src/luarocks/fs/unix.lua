@@ -230,6 +230,10 @@ function unix._unix_mode_scope_to_perms(mode, scope)
       perms = apply_umask("666")
    elseif mode == "exec" and scope == "all" then
       perms = apply_umask("777")
+   elseif mode == "read" and scope == "shared" then
+      perms = "444"
+   elseif mode == "exec" and scope == "shared" then
+      perms = "555"
    else
       return false, "Invalid permission " .. mode .. " for " .. scope
    end
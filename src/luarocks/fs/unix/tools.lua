@@ -145,14 +145,16 @@ end
 
 --- Uncompress files from a .zip archive.
 -- @param zipfile string: pathname of .zip archive to be extracted.
+-- @param ... Names of the files to extract can be given as additional
+-- arguments; by default, all files are extracted.
 -- @return boolean: true on success, nil and error message on failure.
-function tools.unzip(zipfile)
+function tools.unzip(zipfile, ...)
    assert(zipfile)
    local ok, err = fs.is_tool_available(vars.UNZIP, "unzip")
    if not ok then
       return nil, err
    end
-   if fs.execute_quiet(vars.UNZIP, zipfile) then
+   if fs.execute_quiet(vars.UNZIP, zipfile, ...) then
       return true
    else
       return nil, "failed extracting " .. zipfile
@@ -219,7 +221,8 @@ end
 --- Set permissions for file or directory
 -- @param filename string: filename whose permissions are to be modified
 -- @param mode string ("read" or "exec"): permissions to set
--- @param scope string ("user" or "all"): the user(s) to whom the permission applies
+-- @param scope string ("user" or "all"): the user(s) to whom the permission applies,
+-- or "shared" to make a file shared between rocks trees read-only for everyone
 -- @return boolean or (boolean, string): true on success, false on failure,
 -- plus an error message
 function tools.set_permissions(filename, mode, scope)
@@ -233,6 +236,75 @@ function tools.set_permissions(filename, mode, scope)
    return fs.execute(vars.CHMOD, perms, filename)
 end
 
+--- Create a hard link.
+-- @param src string: Pathname of the existing file.
+-- @param dest string: Pathname of the link to create.
+-- @return boolean or (nil, string): true on success, or nil and an
+-- error message.
+function tools.link(src, dest)
+   assert(src and dest)
+   if fs.execute_quiet(vars.LN, src, dest) then
+      return true
+   end
+   return nil, "Failed linking "..src.." to "..dest
+end
+
+--- Create a reflink, a copy sharing the blocks of the original file
+-- until either of them is modified. Only some filesystems support it.
+-- @param src string: Pathname of the existing file.
+-- @param dest string: Pathname of the copy to create.
+-- @return boolean or (nil, string): true on success, or nil and an
+-- error message.
+function tools.reflink(src, dest)
+   assert(src and dest)
+   if fs.execute_quiet(vars.CP, "--reflink=always", src, dest) then
+      return true
+   end
+   return nil, "Failed making a reflink of "..src.." at "..dest
+end
+
+--- Get the number of hard links to a file.
+-- @param file string: pathname of the file.
+-- @return integer or nil: the number of links, or nil if it is unknown.
+function tools.link_count(file)
+   local pipe = io.popen(fs.quiet_stderr(vars.LS.." -ld "..fs.Q(file)))
+   local line = pipe:read("*l")
+   pipe:close()
+   return line and tonumber(line:match("^%S+%s+(%d+)"))
+end
+
+--- Set permissions for several files or directories, running chmod
+-- once for as many files as fit in a command line.
+-- @param filenames table: filenames whose permissions are to be modified
+-- @param mode string ("read" or "exec"): permissions to set
+-- @param scope string ("user" or "all"): the user(s) to whom the permission applies
+-- @return boolean or (boolean, string): true on success, false on failure,
+-- plus an error message
+function tools.set_permissions_many(filenames, mode, scope)
+   assert(filenames and mode and scope)
+
+   local perms, err = fs._unix_mode_scope_to_perms(mode, scope)
+   if err then
+      return false, err
+   end
+
+   local i = 1
+   while i <= #filenames do
+      local cmd = { vars.CHMOD, perms }
+      local cmd_len = 0
+      repeat
+         local arg = fs.Q(filenames[i])
+         table.insert(cmd, arg)
+         cmd_len = cmd_len + #arg + 1
+         i = i + 1
+      until i > #filenames or cmd_len > 100000
+      if not fs.execute_string(table.concat(cmd, " ")) then
+         return false, "Failed setting permissions of "..cmd[3]..(#cmd > 3 and " and other files" or "")
+      end
+   end
+   return true
+end
+
 function tools.browser(url)
    return fs.execute(cfg.web_browser, url)
 end
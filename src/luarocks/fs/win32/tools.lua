@@ -157,10 +157,12 @@ end
 
 --- Uncompress files from a .zip archive.
 -- @param zipfile string: pathname of .zip archive to be extracted.
+-- @param ... Names of the files to extract can be given as additional
+-- arguments; by default, all files are extracted.
 -- @return boolean: true on success, nil and error message on failure.
-function tools.unzip(zipfile)
+function tools.unzip(zipfile, ...)
    assert(zipfile)
-   if fs.execute_quiet(vars.SEVENZ.." -aoa x", zipfile) then
+   if fs.execute_quiet(vars.SEVENZ.." -aoa x", zipfile, ...) then
       return true
    else
       return nil, "failed extracting " .. zipfile
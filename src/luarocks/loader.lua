@@ -1,4 +1,4 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local debug = _tl_compat and _tl_compat.debug or debug; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local package = _tl_compat and _tl_compat.package or package; local pairs = _tl_compat and _tl_compat.pairs or pairs; local pcall = _tl_compat and _tl_compat.pcall or pcall; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local debug = _tl_compat and _tl_compat.debug or debug; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local loadfile = _tl_compat and _tl_compat.loadfile or loadfile; local os = _tl_compat and _tl_compat.os or os; local package = _tl_compat and _tl_compat.package or package; local pairs = _tl_compat and _tl_compat.pairs or pairs; local pcall = _tl_compat and _tl_compat.pcall or pcall; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
 
 
 
@@ -26,6 +26,20 @@ end
 local path = require("luarocks.core.path")
 local manif = require("luarocks.core.manif")
 local vers = require("luarocks.core.vers")
+local dir = require("luarocks.core.dir")
+local persist = require("luarocks.core.persist")
+local util = require("luarocks.core.util")
+
+
+
+
+
+
+
+
+
+
+
 
 
 
@@ -82,6 +96,63 @@ end
 loader.context = {}
 
 
+local context_generation = 0
+
+
+
+
+
+
+
+
+
+
+local function find_closure(name, version, tree_indexes)
+   for _, tree in ipairs(tree_indexes) do
+      local versions = tree.index.dependencies and tree.index.dependencies[name]
+      local closure = versions and versions[version]
+      if closure then
+         return closure
+      end
+   end
+   return nil
+end
+
+
+
+
+
+
+
+
+
+
+
+local function add_closure_to_context(name, version, tree_indexes)
+   local closure = find_closure(name, version, tree_indexes)
+   if not closure then
+      return false
+   end
+
+   local context = loader.context
+   for dep_name, dep_version in pairs(closure) do
+      local current = context[dep_name]
+      if current and current ~= dep_version then
+         return false
+      end
+      if not find_closure(dep_name, dep_version, tree_indexes) then
+         return false
+      end
+   end
+
+   context[name] = version
+   for dep_name, dep_version in pairs(closure) do
+      context[dep_name] = dep_version
+   end
+   return true
+end
+
+
 
 
 
@@ -94,12 +165,22 @@ function loader.add_context(name, version)
       temporary_global = false
    end
 
+   if loader.context[name] then
+      return
+   end
+
+   if add_closure_to_context(name, version, manif.load_rocks_tree_module_indexes()) then
+      context_generation = context_generation + 1
+      return
+   end
+
    local tree_manifests = manif.load_rocks_tree_manifests()
    if not tree_manifests then
       return
    end
 
    manif.scan_dependencies(name, version, tree_manifests, loader.context)
+   context_generation = context_generation + 1
 end
 
 
@@ -156,18 +237,56 @@ end
 
 
 
+local function load_from_file(module, file_name, bytecode_file)
+   if file_name:match("%.lua$") then
+      if bytecode_file then
+         local f = loadfile(bytecode_file)
+         if f then
+            return f
+         end
+      end
+      return loadfile(file_name)
+   end
+   if file_name:sub(-(#cfg.lib_extension + 1)) ~= "." .. cfg.lib_extension then
+      return nil
+   end
+
+   local symbol = module:gsub("%.", "_")
+   local before, after = symbol:match("^([^%-]*)%-(.*)$")
+   if before then
+      local f = package.loadlib(file_name, "luaopen_" .. before)
+      if f then
+         return f
+      end
+      symbol = after
+   end
+   return package.loadlib(file_name, "luaopen_" .. symbol)
+end
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 
 
 local function add_providers(providers, entries, tree, module, filter_name)
    for i, entry in ipairs(entries) do
-      local name, version = entry:match("^([^/]*)/(.*)$")
+      local name, version, file_name = entry[1], entry[2], entry[3]
 
-      local file_name = tree.manifest.repository[name][version][1].modules[module]
       if type(file_name) ~= "string" then
          error("Invalid data in manifest file for module " .. tostring(module) .. " (invalid data for " .. tostring(name) .. " " .. tostring(version) .. ")")
       end
 
-      file_name = filter_name(file_name, name, version, tree.tree, i)
+      file_name = filter_name(file_name, name, version, tree, i)
 
       if loader.context[name] == version then
          return name, version, file_name
@@ -196,25 +315,25 @@ end
 
 local function select_module(module, filter_name)
 
-   local tree_manifests = manif.load_rocks_tree_manifests()
-   if not tree_manifests then
+   local tree_indexes = manif.load_rocks_tree_module_indexes()
+   if not tree_indexes then
       return nil
    end
 
    local providers = {}
    local initmodule
-   for _, tree in ipairs(tree_manifests) do
-      local entries = tree.manifest.modules[module]
+   for _, tree in ipairs(tree_indexes) do
+      local entries = tree.index.modules[module]
       if entries then
-         local n, v, f = add_providers(providers, entries, tree, module, filter_name)
+         local n, v, f = add_providers(providers, entries, tree.tree, module, filter_name)
          if n then
             return n, v, f
          end
       else
          initmodule = initmodule or module .. ".init"
-         entries = tree.manifest.modules[initmodule]
+         entries = tree.index.modules[initmodule]
          if entries then
-            local n, v, f = add_providers(providers, entries, tree, initmodule, filter_name)
+            local n, v, f = add_providers(providers, entries, tree.tree, initmodule, filter_name)
             if n then
                return n, v, f
             end
@@ -249,6 +368,162 @@ end
 
 
 
+local rock_manifest_lua_entries = {}
+
+
+
+local bytecode_stamps = {}
+
+
+
+
+
+
+
+
+
+
+
+
+local function bytecode_is_current(file_name, name, version, tree, i)
+   local stamps_file = path.bytecode_stamps_file(name, version, tree)
+   local stamps = bytecode_stamps[stamps_file]
+   if not stamps then
+      local data = persist.load_into_table(stamps_file)
+      stamps = data and data.stamps or {}
+      bytecode_stamps[stamps_file] = stamps
+   end
+
+   local recorded = stamps[file_name]
+   local current = recorded and util.file_stamp(path.which_i(file_name, name, version, tree, i))
+   if not current or current.size ~= recorded.size then
+      return false
+   end
+   return not (current.mtime and recorded.mtime) or current.mtime == recorded.mtime
+end
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+local function filter_bytecode_name(file_name, name, version, tree, i)
+   if not file_name:match("%.lua$") then
+      return nil
+   end
+
+   local rock_manifest_file = dir.path(path.rocks_dir(tree), name, version, "rock_manifest")
+   local lua_entries = rock_manifest_lua_entries[rock_manifest_file]
+   if not lua_entries then
+      local rock_manifest = persist.load_into_table(rock_manifest_file)
+      local entries = rock_manifest and rock_manifest.rock_manifest and rock_manifest.rock_manifest.lua
+      lua_entries = type(entries) == "table" and entries or {}
+      rock_manifest_lua_entries[rock_manifest_file] = lua_entries
+   end
+
+   local entry = lua_entries
+   for part in file_name:gmatch("[^/]+") do
+      if type(entry) == "string" then
+         return nil
+      end
+      entry = entry[part]
+      if not entry then
+         return nil
+      end
+   end
+   if type(entry) == "string" and bytecode_is_current(file_name, name, version, tree, i) then
+      return path.bytecode_file(name, version, entry, tree)
+   end
+end
+
+
+
+
+
+
+
+local resolved = {}
+
+
+
+local not_found = {}
+
+
+local memo_rocks_dirs = {}
+local memo_rocks_trees
+local memo_root_dir
+local memo_index_generation
+local memo_context_generation
+local memo_checked_at
+
+
+
+
+
+
+
+
+local function memo_trees_are_current()
+   if memo_rocks_trees ~= cfg.rocks_trees or
+   memo_root_dir ~= cfg.root_dir or
+   memo_index_generation ~= manif.get_module_index_generation() then
+      return false
+   end
+   local now = os.time()
+   if memo_context_generation == context_generation and
+   now - memo_checked_at < (cfg.loader_check_interval or 0) then
+      return true
+   end
+   memo_checked_at = now
+   for _, rocks_dir in ipairs(memo_rocks_dirs) do
+      if not manif.module_index_is_current(rocks_dir) then
+         return false
+      end
+   end
+   return true
+end
+
+
+local function check_memo()
+   if not memo_trees_are_current() then
+      resolved = {}
+      not_found = {}
+      rock_manifest_lua_entries = {}
+
+      memo_rocks_dirs = {}
+      path.map_trees(nil, function(tree)
+         local rocks_dir = path.rocks_dir(tree)
+         manif.fast_load_local_module_index(rocks_dir)
+         table.insert(memo_rocks_dirs, rocks_dir)
+      end)
+      memo_rocks_trees = cfg.rocks_trees
+      memo_root_dir = cfg.root_dir
+      memo_index_generation = manif.get_module_index_generation()
+      memo_context_generation = context_generation
+      memo_checked_at = os.time()
+   elseif memo_context_generation ~= context_generation then
+      resolved = {}
+      memo_context_generation = context_generation
+   end
+end
+
+
+
+
+
+
+
+
+
+
 
 
 
@@ -256,7 +531,36 @@ end
 
 
 local function pick_module(module)
-   return select_module(module, filter_module_name)
+   check_memo()
+
+   local found = resolved[module]
+   if found then
+      return found.name, found.version, found.module_name, found.file_name, found.bytecode_file
+   end
+   if not_found[module] then
+      return nil
+   end
+
+   local name, version, module_name = select_module(module, filter_module_name)
+   if not name then
+      not_found[module] = true
+      return nil
+   end
+
+   local bytecode_file
+   if cfg.lua_bytecode_cache then
+      local _, _, bytecode_name = select_module(module, filter_bytecode_name)
+      bytecode_file = bytecode_name
+   end
+
+   local file_name
+   if cfg.loader_direct_paths or bytecode_file then
+      local _, _, which_file = select_module(module, path.which_i)
+      file_name = which_file
+   end
+
+   resolved[module] = { name = name, version = version, module_name = module_name, file_name = file_name, bytecode_file = bytecode_file }
+   return name, version, module_name, file_name, bytecode_file
 end
 
 
@@ -311,11 +615,17 @@ end
 
 
 function loader.luarocks_loader(module)
-   local name, version, module_name = pick_module(module)
+   local name, version, module_name, file_name, bytecode_file = pick_module(module)
    if not name then
       return "No LuaRocks module found for " .. module
    else
       loader.add_context(name, version)
+      if file_name then
+         local f = load_from_file(module, file_name, bytecode_file)
+         if f then
+            return f, file_name
+         end
+      end
       return call_other_loaders(module, name, version, module_name)
    end
 end
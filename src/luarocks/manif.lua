@@ -9,6 +9,20 @@ local manif = {}
 
 
 
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 
 
 
@@ -28,12 +42,43 @@ local type_manifest = require("luarocks.type.manifest")
 
 
 
+
+
 manif.cache_manifest = core.cache_manifest
 manif.load_rocks_tree_manifests = core.load_rocks_tree_manifests
 manif.scan_dependencies = core.scan_dependencies
+manif.make_module_index = core.make_module_index
+manif.cache_module_index = core.cache_module_index
+manif.journal_module_index = core.journal_module_index
+manif.journal_is_orphaned = core.journal_is_orphaned
+manif.manifest_stamp_line = core.manifest_stamp_line
+manif.journal_header_line = core.journal_header_line
+manif.read_manifest_stamp = core.read_manifest_stamp
+manif.read_journal_base = core.read_journal_base
+manif.make_delta = core.make_delta
+manif.apply_delta = core.apply_delta
+manif.loader_index_file = core.loader_index_file
+manif.journal_file = core.journal_file
 
 manif.rock_manifest_cache = {}
 
+
+
+manif.shard_index_file = "index"
+
+
+
+local shard_indexes = {}
+local no_shards = {}
+
+
+
+local shard_cache = {}
+
+
+
+manif.delta_index_file = "current"
+
 local function check_manifest(repo_url, manifest, globals)
    local ok, err = type_manifest.check(manifest, globals)
    if not ok then
@@ -84,6 +129,76 @@ end
 
 
 
+function manif.deltas_dir(lua_version)
+   return "manifest-" .. lua_version .. ".deltas"
+end
+
+
+
+
+
+
+
+
+
+
+local function update_cached_manifest(repo_url, lua_version)
+   local cached = fetch.cache_pathname(dir.path(repo_url, "manifest-" .. lua_version))
+   if not fs.exists(cached) then
+      return nil
+   end
+
+   local deltas_dir = manif.deltas_dir(lua_version)
+   local index_file = fetch.fetch_caching(dir.path(repo_url, deltas_dir, manif.delta_index_file), "no_mirror")
+   local index = index_file and persist.load_into_table(index_file)
+   if not (index and type(index.revision) == "string" and type(index.deltas) == "table") then
+      return nil
+   end
+
+   local revision = fs.get_md5(cached)
+   if revision == index.revision then
+      return cached
+   end
+   local has_delta = false
+   for _, rev in ipairs(index.deltas) do
+      if rev == revision then
+         has_delta = true
+         break
+      end
+   end
+   if not has_delta then
+      return nil
+   end
+
+   local delta_file = fetch.fetch_caching(dir.path(repo_url, deltas_dir, revision .. ".delta"), "no_mirror")
+   local delta = delta_file and persist.load_into_table(delta_file)
+   local manifest = persist.load_into_table(cached)
+   if not (delta and manifest) then
+      return nil
+   end
+   manif.apply_delta(manifest, delta)
+
+   local lock = fs.lock_access(dir.dir_name(cached))
+   if not lock then
+      return nil
+   end
+   local tmp = cached .. ".tmp"
+   local ok = persist.save_from_table(tmp, manifest)
+   if not (ok and fs.get_md5(tmp) == index.revision) then
+      fs.delete(tmp)
+      fs.unlock_access(lock)
+      return nil
+   end
+   ok = fs.replace_file(cached, tmp)
+   fs.unlock_access(lock)
+   return ok and cached or nil
+end
+
+
+
+
+
+
 
 
 
@@ -117,11 +232,14 @@ function manif.load_manifest(repo_url, lua_version, versioned_only)
          end
       end
    else
+      pathname = update_cached_manifest(repo_url, lua_version)
       local err, errcode
-      for _, filename in ipairs(filenames) do
-         pathname, err, errcode, from_cache = fetch.fetch_caching(dir.path(repo_url, filename), "no_mirror")
-         if pathname then
-            break
+      if not pathname then
+         for _, filename in ipairs(filenames) do
+            pathname, err, errcode, from_cache = fetch.fetch_caching(dir.path(repo_url, filename), "no_mirror")
+            if pathname then
+               break
+            end
          end
       end
       if not pathname then
@@ -131,7 +249,7 @@ function manif.load_manifest(repo_url, lua_version, versioned_only)
    if pathname:match(".*%.zip$") then
       pathname = fs.absolute_name(pathname)
       local nozip = pathname:match("(.*)%.zip$")
-      if not from_cache then
+      if not from_cache or not fs.exists(nozip) then
          local dirname = dir.dir_name(pathname)
          fs.change_dir(dirname)
          fs.delete(nozip)
@@ -140,6 +258,7 @@ function manif.load_manifest(repo_url, lua_version, versioned_only)
          if not ok then
             fs.delete(pathname)
             fs.delete(pathname .. ".timestamp")
+            fs.delete(pathname .. ".etag")
             return nil, "Failed extracting manifest file: " .. err
          end
       end
@@ -158,6 +277,109 @@ end
 
 
 
+function manif.shards_dir(lua_version)
+   return "manifest-" .. lua_version .. ".shards"
+end
+
+
+
+
+function manif.shard_file(name)
+   return name .. ".manifest"
+end
+
+
+
+
+
+
+
+local function load_server_table(repo_url, filename)
+   local protocol, repodir = dir.split_url(repo_url)
+   local pathname
+   if protocol == "file" then
+      pathname = dir.path(repodir, filename)
+      if not fs.exists(pathname) then
+         return nil, "File not found: " .. pathname, "open"
+      end
+   else
+      local err, errcode
+      pathname, err, errcode = fetch.fetch_caching(dir.path(repo_url, filename), "no_mirror")
+      if not pathname then
+         return nil, err, errcode
+      end
+   end
+   return persist.load_into_table(pathname)
+end
+
+
+
+
+
+
+
+
+
+
+
+
+
+function manif.load_manifest_shard(repo_url, name, lua_version)
+   lua_version = lua_version or cfg.lua_version
+
+   local cached_manifest = core.get_cached_manifest(repo_url, lua_version)
+   if cached_manifest then
+      postprocess_dependencies(cached_manifest)
+      return cached_manifest
+   end
+
+   no_shards[lua_version] = no_shards[lua_version] or {}
+   shard_indexes[lua_version] = shard_indexes[lua_version] or {}
+   shard_cache[lua_version] = shard_cache[lua_version] or {}
+   if no_shards[lua_version][repo_url] then
+      return nil, "No manifest shards found at " .. repo_url, "noshards"
+   end
+
+   local shards_dir = manif.shards_dir(lua_version)
+   local packages = shard_indexes[lua_version][repo_url]
+   if not packages then
+      local index = load_server_table(repo_url, dir.path(shards_dir, manif.shard_index_file))
+      if not (index and type(index.packages) == "table") then
+         no_shards[lua_version][repo_url] = true
+         return nil, "No manifest shards found at " .. repo_url, "noshards"
+      end
+      packages = index.packages
+      shard_indexes[lua_version][repo_url] = packages
+   end
+
+   local shards = shard_cache[lua_version][repo_url] or {}
+   shard_cache[lua_version][repo_url] = shards
+   if shards[name] then
+      return shards[name]
+   end
+
+   local manifest
+   if packages[name] then
+      local shard, globals, errcode = load_server_table(repo_url, dir.path(shards_dir, manif.shard_file(name)))
+      if not shard then
+         return nil, "Failed loading manifest shard for " .. name .. ": " .. tostring(globals), errcode
+      end
+      manifest = shard
+      local ok, err = type_manifest.check(manifest, globals)
+      if not ok then
+         return nil, "Error checking manifest shard for " .. name .. ": " .. err, "type"
+      end
+   else
+      manifest = { repository = {}, modules = {}, commands = {} }
+   end
+   shards[name] = manifest
+   return manifest
+end
+
+
+
+
+
 function manif.get_provided_item(deploy_type, file_path)
    local item_type = deploy_type == "bin" and "command" or "module"
    local item_name = item_type == "command" and file_path or path.path_to_module(file_path)
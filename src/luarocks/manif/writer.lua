@@ -1,4 +1,4 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local assert = _tl_compat and _tl_compat.assert or assert; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local assert = _tl_compat and _tl_compat.assert or assert; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
 local writer = {}
 
 
@@ -32,6 +32,9 @@ local queries = require("luarocks.queries")
 
 
 
+
+
+
 
 
 local function store_package_items(storage, name, version, items)
@@ -89,23 +92,77 @@ end
 
 
 
+local function same_closure(a, b)
+   if not (a and b) then
+      return a == b
+   end
+   for k, v in pairs(a) do
+      if b[k] ~= v then
+         return false
+      end
+   end
+   for k in pairs(b) do
+      if a[k] == nil then
+         return false
+      end
+   end
+   return true
+end
+
+
+
+
 
 
 
 
-local function update_dependencies(manifest, deps_mode)
+
+
+
+
+
+
+local function update_dependencies(manifest, deps_mode, changes, affected)
 
    if not manifest.dependencies then manifest.dependencies = {} end
    local mdeps = manifest.dependencies
 
+   local known = {}
+   if changes then
+      for pkg, versions in pairs(mdeps) do
+         known[pkg] = {}
+         for version in pairs(versions) do
+            known[pkg][version] = true
+         end
+      end
+   end
+
    for pkg, versions in pairs(manifest.repository) do
       for version, repositories in pairs(versions) do
          for _, repo in ipairs(repositories) do
-            if repo.arch == "installed" then
+            if repo.arch == "installed" and (not affected or affected[pkg]) then
                local rd = {}
+               local previous = repo.dependencies
                repo.dependencies = rd
                deps.scan_deps(rd, mdeps, pkg, version, deps_mode)
                rd[pkg] = nil
+               if changes and not same_closure(previous, rd) then
+                  changes.repository[pkg] = true
+               end
+            end
+         end
+      end
+   end
+
+   if changes then
+      for pkg, versions in pairs(mdeps) do
+         if not known[pkg] then
+            changes.dependencies[pkg] = true
+         else
+            for version in pairs(versions) do
+               if not known[pkg][version] then
+                  changes.dependencies[pkg] = true
+               end
             end
          end
       end
@@ -119,6 +176,40 @@ end
 
 
 
+local function find_affected(manifest, name)
+   local mdeps = manifest.dependencies or {}
+   local affected = { [name] = true }
+   local found = true
+   while found do
+      found = false
+      for pkg, versions in pairs(manifest.repository) do
+         if not affected[pkg] then
+            for version in pairs(versions) do
+               local queries = mdeps[pkg] and mdeps[pkg][version]
+               local depends = not queries
+               for _, dep in ipairs(queries or {}) do
+                  if affected[dep.name] then
+                     depends = true
+                     break
+                  end
+               end
+               if depends then
+                  affected[pkg] = true
+                  found = true
+                  break
+               end
+            end
+         end
+      end
+   end
+   return affected
+end
+
+
+
+
+
+
 
 
 local function sort_pkgs(a, b)
@@ -253,10 +344,263 @@ local function save_table(where, name, tbl)
    return ok, err
 end
 
+
+
+
+
+
+
+
+local function make_stamp(filename)
+   local md5 = fs.get_md5(filename)
+   if md5 then
+      return string.format("%x", os.time()) .. md5:sub(1, 16)
+   end
+   local address = tostring({}):match("(%x+)$") or ""
+   return string.format("%x%s%x", os.time(), address, math.floor(os.clock() * 1000000))
+end
+
+
+
+
+
+
+
+
+
+
+local function save_tree_manifest(rocks_dir, manifest)
+   local filename = dir.path(rocks_dir, "manifest")
+   local ok, err = persist.save_from_table(filename .. ".tmp", manifest)
+   if not ok then
+      return nil, err
+   end
+   local stamp = make_stamp(filename .. ".tmp")
+   local index = manif.make_module_index(manifest, stamp)
+   ok, err = save_table(rocks_dir, manif.loader_index_file, index)
+   if not ok then
+      os.remove(filename .. ".tmp")
+      return nil, err
+   end
+   local fd = io.open(filename .. ".tmp", "a")
+   if fd then
+      fd:write(manif.manifest_stamp_line(stamp))
+      fd:close()
+   end
+   ok, err = fs.replace_file(filename, filename .. ".tmp")
+   if not ok then
+      return nil, err
+   end
+   local journal = dir.path(rocks_dir, manif.journal_file)
+   if fs.exists(journal) then
+      fs.delete(journal)
+   end
+   manif.cache_module_index(rocks_dir, index)
+   return true
+end
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+local function journal_tree_manifest(rocks_dir, manifest, changes)
+   local journal = dir.path(rocks_dir, manif.journal_file)
+   local base, manifest_size = manif.read_manifest_stamp(dir.path(rocks_dir, "manifest"))
+   if not base then
+      return save_tree_manifest(rocks_dir, manifest)
+   end
+   local _, journal_size = manif.read_manifest_stamp(journal)
+   if journal_size then
+      if manif.read_journal_base(journal) ~= base or journal_size > manifest_size / 4 then
+         return save_tree_manifest(rocks_dir, manifest)
+      end
+   end
+
+   local delta = {}
+   local tables = manifest
+   for field, keys in pairs(changes) do
+      local entries = tables[field] or {}
+      local values = {}
+      for k in pairs(keys) do
+         local v = entries[k]
+         if v == nil then
+            v = false
+         end
+         values[k] = v
+      end
+      delta[field] = values
+   end
+   local data, err = persist.save_from_table_to_string({ entry = delta })
+   if not data then
+      return nil, err
+   end
+
+   local fd = io.open(journal, "ab")
+   if not fd then
+      return nil, "Cannot write to " .. journal
+   end
+   if not journal_size then
+      fd:write(manif.journal_header_line(base))
+   end
+   fd:write(data)
+   fd:close()
+   manif.journal_module_index(rocks_dir, delta)
+   return true
+end
+
+
+
+
+
+
+
+
+
+
+
+local function save_shards(repo, lua_version, manifest)
+   local shards_dir = dir.path(repo, manif.shards_dir(lua_version))
+   local ok, err = fs.make_dir(shards_dir)
+   if not ok then
+      return nil, err
+   end
+
+   local files = {}
+   local packages = {}
+   for name, versions in pairs(manifest.repository) do
+      local shard = { repository = { [name] = versions }, modules = {}, commands = {} }
+      local file = manif.shard_file(name)
+      ok, err = save_table(shards_dir, file, shard)
+      if not ok then
+         return nil, err
+      end
+      files[file] = true
+      packages[name] = true
+   end
+   ok, err = save_table(shards_dir, manif.shard_index_file, { packages = packages })
+   if not ok then
+      return nil, err
+   end
+
+   for _, file in ipairs(fs.list_dir(shards_dir)) do
+      if file ~= manif.shard_index_file and not files[file] then
+         fs.delete(dir.path(shards_dir, file))
+      end
+   end
+   return true
+end
+
+
+
+
+local function has_shards(repo)
+   for luaver in util.lua_versions() do
+      if fs.exists(dir.path(repo, manif.shards_dir(luaver), manif.shard_index_file)) then
+         return true
+      end
+   end
+   return false
+end
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+local function save_deltas(repo, lua_version, manifest, previous, keep)
+   local deltas_dir = dir.path(repo, manif.deltas_dir(lua_version))
+   local revision, err = fs.get_md5(dir.path(repo, "manifest-" .. lua_version))
+   if not revision then
+      return nil, err
+   end
+
+   local index = persist.load_into_table(dir.path(deltas_dir, manif.delta_index_file)) or {}
+   local history = {}
+   if previous and previous ~= revision then
+      table.insert(history, previous)
+   end
+   for _, rev in ipairs((index.deltas or {})) do
+      if #history < keep and rev ~= revision and rev ~= previous then
+         table.insert(history, rev)
+      end
+   end
+
+   local revisions = {}
+   local kept = {}
+   for _, rev in ipairs(history) do
+      local old = persist.load_into_table(dir.path(deltas_dir, rev .. ".manifest"))
+      if old then
+         local ok
+         ok, err = save_table(deltas_dir, rev .. ".delta", manif.make_delta(old, manifest))
+         if not ok then
+            return nil, err
+         end
+         table.insert(revisions, rev)
+         kept[rev] = true
+      end
+   end
+
+   local ok
+   ok, err = save_table(deltas_dir, manif.delta_index_file, { revision = revision, deltas = revisions, keep = keep })
+   if not ok then
+      return nil, err
+   end
+
+   for _, file in ipairs(fs.list_dir(deltas_dir)) do
+      local rev = file:match("^(%x+)%.[a-z]+$")
+      if rev and not kept[rev] then
+         fs.delete(dir.path(deltas_dir, file))
+      end
+   end
+   return true
+end
+
+
+
+
+
+local function get_delta_revisions(repo)
+   for luaver in util.lua_versions() do
+      local index = persist.load_into_table(dir.path(repo, manif.deltas_dir(luaver), manif.delta_index_file))
+      if index and type(index.keep) == "number" then
+         return math.floor(index.keep)
+      end
+   end
+end
+
 function writer.make_rock_manifest(name, version)
    local install_dir = path.install_dir(name, version)
    local tree = {}
-   for _, file in ipairs(fs.find(install_dir)) do
+   local files = fs.find(install_dir)
+   local full_paths = {}
+   for _, file in ipairs(files) do
+      local full_path = dir.path(install_dir, file)
+      if fs.is_file(full_path) then
+         table.insert(full_paths, full_path)
+      end
+   end
+   local sums, err = fs.get_checksums(full_paths)
+   if not sums then
+      return nil, "Failed producing checksum: " .. tostring(err)
+   end
+   for _, file in ipairs(files) do
       local full_path = dir.path(install_dir, file)
       local walk = tree
       local last
@@ -273,13 +617,8 @@ function writer.make_rock_manifest(name, version)
          assert(type(nxt) == "table")
          walk = nxt
       end
-      if fs.is_file(full_path) then
-
-         local sum, err = fs.get_md5(full_path)
-         if not sum then
-            return nil, "Failed producing checksum: " .. tostring(err)
-         end
-         last[last_name] = sum
+      if sums[full_path] then
+         last[last_name] = sums[full_path]
       end
    end
    local rock_manifest = { rock_manifest = tree }
@@ -321,7 +660,13 @@ end
 
 
 
-function writer.make_manifest(repo, deps_mode, remote)
+
+
+
+
+
+
+function writer.make_manifest(repo, deps_mode, remote, shards, deltas)
 
    if deps_mode == "none" then deps_mode = cfg.deps_mode end
 
@@ -339,13 +684,41 @@ function writer.make_manifest(repo, deps_mode, remote)
    if not ok then return nil, err end
 
    if remote then
+      if shards == nil then
+         shards = has_shards(repo)
+      end
+      if deltas == nil then
+         deltas = get_delta_revisions(repo)
+      end
       local cache = {}
       for luaver in util.lua_versions() do
          local vmanifest = { repository = {}, modules = {}, commands = {} }
          ok, err = store_results(results, vmanifest)
          filter_by_lua_version(vmanifest, luaver, repo, cache)
          if not cfg.no_manifest then
+            local previous
+            local manifest_file = dir.path(repo, "manifest-" .. luaver)
+            if deltas and fs.exists(manifest_file) then
+               previous = fs.get_md5(manifest_file)
+               if previous then
+                  local deltas_dir = dir.path(repo, manif.deltas_dir(luaver))
+                  fs.make_dir(deltas_dir)
+                  fs.copy(manifest_file, dir.path(deltas_dir, previous .. ".manifest"))
+               end
+            end
             save_table(repo, "manifest-" .. luaver, vmanifest)
+            if deltas then
+               ok, err = save_deltas(repo, luaver, vmanifest, previous, deltas)
+               if not ok then
+                  return nil, "Failed writing manifest deltas: " .. err
+               end
+            end
+            if shards then
+               ok, err = save_shards(repo, luaver, vmanifest)
+               if not ok then
+                  return nil, "Failed writing manifest shards: " .. err
+               end
+            end
          end
       end
    else
@@ -356,6 +729,9 @@ function writer.make_manifest(repo, deps_mode, remote)
 
       return true
    end
+   if not remote then
+      return save_tree_manifest(repo, manifest)
+   end
    return save_table(repo, "manifest", manifest)
 end
 
@@ -376,6 +752,12 @@ function writer.add_to_manifest(name, version, repo, deps_mode)
 
    if deps_mode == "none" then deps_mode = cfg.deps_mode end
 
+   if manif.journal_is_orphaned(rocks_dir) then
+
+
+      return writer.make_manifest(rocks_dir, deps_mode)
+   end
+
    local manifest, err = manif.load_manifest(rocks_dir)
    if not manifest then
       util.printerr("No existing manifest. Attempting to rebuild...")
@@ -391,12 +773,21 @@ function writer.add_to_manifest(name, version, repo, deps_mode)
    ok, err = store_results(results, manifest)
    if not ok then return nil, err end
 
-   update_dependencies(manifest, deps_mode)
+   local changes = { repository = { [name] = true }, modules = {}, commands = {}, dependencies = {} }
+   local entry = manifest.repository[name][version][1]
+   for item in pairs(entry.modules) do
+      changes.modules[item] = true
+   end
+   for item in pairs(entry.commands) do
+      changes.commands[item] = true
+   end
+
+   update_dependencies(manifest, deps_mode, changes, find_affected(manifest, name))
 
    if cfg.no_manifest then
       return true
    end
-   return save_table(rocks_dir, "manifest", manifest)
+   return journal_tree_manifest(rocks_dir, manifest, changes)
 end
 
 
@@ -416,6 +807,11 @@ function writer.remove_from_manifest(name, version, repo, deps_mode)
 
    if deps_mode == "none" then deps_mode = cfg.deps_mode end
 
+   if manif.journal_is_orphaned(rocks_dir) then
+
+      return writer.make_manifest(rocks_dir, deps_mode)
+   end
+
    local manifest, _err = manif.load_manifest(rocks_dir)
    if not manifest then
       util.printerr("No existing manifest. Attempting to rebuild...")
@@ -436,6 +832,15 @@ function writer.remove_from_manifest(name, version, repo, deps_mode)
       return writer.make_manifest(rocks_dir, deps_mode)
    end
 
+   local changes = { repository = { [name] = true }, modules = {}, commands = {}, dependencies = { [name] = true } }
+   for item in pairs(version_entry.modules) do
+      changes.modules[item] = true
+      changes.modules[item .. ".init"] = true
+   end
+   for item in pairs(version_entry.commands) do
+      changes.commands[item] = true
+   end
+
    remove_package_items(manifest.modules, name, version, version_entry.modules)
    remove_package_items(manifest.commands, name, version, version_entry.commands)
 
@@ -448,12 +853,12 @@ function writer.remove_from_manifest(name, version, repo, deps_mode)
       manifest.dependencies[name] = nil
    end
 
-   update_dependencies(manifest, deps_mode)
+   update_dependencies(manifest, deps_mode, changes, find_affected(manifest, name))
 
    if cfg.no_manifest then
       return true
    end
-   return save_table(rocks_dir, "manifest", manifest)
+   return journal_tree_manifest(rocks_dir, manifest, changes)
 end
 
 return writer
@@ -20,6 +20,9 @@ local path = {}
 
 
 
+
+
+
 path.rocks_dir = core.rocks_dir
 path.versioned_name = core.versioned_name
 path.path_to_module = core.path_to_module
@@ -27,6 +30,9 @@ path.deploy_lua_dir = core.deploy_lua_dir
 path.deploy_lib_dir = core.deploy_lib_dir
 path.map_trees = core.map_trees
 path.rocks_tree_to_string = core.rocks_tree_to_string
+path.bytecode_dir = core.bytecode_dir
+path.bytecode_file = core.bytecode_file
+path.bytecode_stamps_file = core.bytecode_stamps_file
 
 function path.root_dir(tree)
    if type(tree) == "string" then
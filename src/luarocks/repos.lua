@@ -1,4 +1,4 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local assert = _tl_compat and _tl_compat.assert or assert; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local os = _tl_compat and _tl_compat.os or os; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local assert = _tl_compat and _tl_compat.assert or assert; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local loadfile = _tl_compat and _tl_compat.loadfile or loadfile; local os = _tl_compat and _tl_compat.os or os; local pairs = _tl_compat and _tl_compat.pairs or pairs; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local type = type
 
 local repos = { Op = {}, Paths = {} }
 
@@ -16,12 +16,15 @@ local repos = { Op = {}, Paths = {} }
 
 
 
+
 local fs = require("luarocks.fs")
 local path = require("luarocks.path")
 local cfg = require("luarocks.core.cfg")
 local util = require("luarocks.util")
 local dir = require("luarocks.dir")
 local manif = require("luarocks.manif")
+local persist = require("luarocks.persist")
+local shared_store = require("luarocks.shared_store")
 local vers = require("luarocks.core.vers")
 
 
@@ -50,6 +53,10 @@ local vers = require("luarocks.core.vers")
 
 
 
+
+
+
+
 
 
 
@@ -267,7 +274,11 @@ end
 
 local function backup_existing(should_backup, target)
    if not should_backup then
-      fs.delete(target)
+
+
+      if not os.remove(target) and fs.exists(target) then
+         fs.delete(target)
+      end
       return
    end
    if fs.exists(target) then
@@ -285,61 +296,126 @@ local function backup_existing(should_backup, target)
    end
 end
 
-local function prepare_op_install()
-   local mkdirs = {}
-   local rmdirs = {}
 
-   local function memoize_mkdir(d)
-      if mkdirs[d] then
-         return true
+
+
+
+
+
+
+
+
+
+
+local function leaf_dirs(dirs)
+   local parents = {}
+   for d in pairs(dirs) do
+      local parent = dir.dir_name(d)
+      while parent ~= "" and not parents[parent] do
+         parents[parent] = true
+         parent = dir.dir_name(parent)
       end
-      local ok, err = fs.make_dir(d)
-      if not ok then
-         return nil, err
+   end
+   local leaves = {}
+   for d in pairs(dirs) do
+      if not parents[d] then
+         table.insert(leaves, d)
       end
-      mkdirs[d] = true
-      return true
    end
+   table.sort(leaves)
+   return leaves
+end
+
+
+
+
 
-   local function op_install(op)
-      local ok, err = memoize_mkdir(dir.dir_name(op.dst))
+
+
+
+
+
+
+
+
+
+local function run_installs(installs)
+   local journal = {}
+   local dst_dirs = {}
+   local src_dirs = {}
+   local moved = { read = {}, exec = {} }
+
+   local function rollback(err)
+      for i = #journal, 1, -1 do
+         local step = journal[i]
+         if step.action == "install" then
+            fs.delete(step.dst)
+         elseif not os.rename(step.dst, step.src) then
+            fs.move(step.dst, step.src)
+         end
+      end
+      for d in pairs(dst_dirs) do
+         fs.remove_dir_tree_if_empty(d)
+      end
+      return nil, err
+   end
+
+   for _, op in ipairs(installs) do
+      dst_dirs[dir.dir_name(op.dst)] = true
+   end
+   for _, d in ipairs(leaf_dirs(dst_dirs)) do
+      local ok, err = fs.make_dir(d)
       if not ok then
-         return nil, err
+         return rollback(err)
       end
+   end
 
-      local backup
-      backup, err = backup_existing(op.backup, op.dst)
+   for _, op in ipairs(installs) do
+      local backup, err = backup_existing(op.backup, op.dst)
       if err then
-         return nil, err
+         return rollback(err)
       end
       if backup then
          op.backup_file = backup
+         table.insert(journal, { action = "backup", src = op.dst, dst = backup })
       end
 
-      ok, err = op.fn(op.src, op.dst, op.backup)
-      if not ok then
-         return nil, err
+      local ok
+      if op.perms then
+         if os.rename(op.src, op.dst) then
+            table.insert(moved[op.perms], op.dst)
+         else
+            ok, err = fs.move(op.src, op.dst, op.perms)
+            if not ok then
+               return rollback(err)
+            end
+         end
+         table.insert(journal, { action = "move", src = op.src, dst = op.dst })
+      else
+         ok, err = op.fn(op.src, op.dst, op.backup)
+         if not ok then
+            return rollback(err)
+         end
+         table.insert(journal, { action = "install", dst = op.dst })
       end
-
-      rmdirs[dir.dir_name(op.src)] = true
-      return true
+      src_dirs[dir.dir_name(op.src)] = true
    end
 
-   local function done_op_install()
-      for d, _ in pairs(rmdirs) do
-         fs.remove_dir_tree_if_empty(d)
+   for perms, files in pairs(moved) do
+      if #files > 0 then
+         local ok, err = fs.set_permissions_many(files, perms, "all")
+         if not ok then
+            return rollback(err)
+         end
       end
    end
+   for perms, files in pairs(moved) do
+      shared_store.share(files, perms)
+   end
 
-   return op_install, done_op_install
-end
-
-local function rollback_install(op)
-   fs.delete(op.dst)
-   if op.backup_file then
-      os.rename(op.backup_file, op.dst)
+   for d in pairs(src_dirs) do
+      fs.remove_dir_tree_if_empty(d)
    end
-   fs.remove_dir_tree_if_empty(dir.dir_name(op.dst))
    return true
 end
 
@@ -433,6 +509,71 @@ end
 
 
 
+local function can_precompile()
+   if _VERSION:sub(5) ~= cfg.lua_version then
+      return false
+   end
+   return (rawget(_G, "jit") ~= nil) == (util.get_luajit_version() ~= nil)
+end
+
+
+
+
+
+
+
+
+
+
+
+local function precompile_lua_files(name, version, lua_files)
+   if not can_precompile() then
+      util.warning("Not precompiling modules of " .. name .. " " .. version .. ": LuaRocks is not running on the Lua interpreter it installs for.")
+      return
+   end
+
+   local bytecode_dir = path.bytecode_dir(name, version)
+   fs.delete(bytecode_dir)
+   local ok, err = fs.make_dir(bytecode_dir)
+   if not ok then
+      util.warning("Could not create bytecode cache " .. bytecode_dir .. ": " .. tostring(err))
+      return
+   end
+
+   local files = util.keys(lua_files)
+   local stamps = {}
+   local hashes, hash_err = fs.get_checksums(files)
+   for _, file in ipairs(files) do
+      local hash
+      local chunk, load_err = loadfile(file)
+      if chunk then
+         hash = hashes and hashes[file]
+         load_err = hash_err
+      end
+      if hash then
+         local fd
+         fd, load_err = io.open(path.bytecode_file(name, version, hash), "wb")
+         if fd then
+            fd:write(string.dump(chunk))
+            fd:close()
+            stamps[lua_files[file]] = util.file_stamp(file)
+         end
+      end
+      if load_err then
+         util.warning("Could not precompile " .. file .. ": " .. tostring(load_err))
+      end
+   end
+
+   local stamps_file = path.bytecode_stamps_file(name, version)
+   ok, err = persist.save_from_table(stamps_file, { stamps = stamps })
+   if not ok then
+      util.warning("Could not write " .. stamps_file .. ": " .. tostring(err))
+   end
+end
+
+
+
+
 
 
 
@@ -446,6 +587,7 @@ function repos.deploy_local_files(name, version, wrap_bin_scripts, deps_mode)
    local repo = cfg.root_dir
    local renames = {}
    local installs = {}
+   local lua_files = {}
 
    local function install_binary(source, target)
       if wrap_bin_scripts and fs.is_lua(source) then
@@ -455,14 +597,6 @@ function repos.deploy_local_files(name, version, wrap_bin_scripts, deps_mode)
       end
    end
 
-   local function move_lua(source, target)
-      return fs.move(source, target, "read")
-   end
-
-   local function move_lib(source, target)
-      return fs.move(source, target, "exec")
-   end
-
    if rock_manifest.bin then
       local source_dir = path.bin_dir(name, version)
       repos.recurse_rock_manifest_entry(rock_manifest.bin, function(file_path)
@@ -514,7 +648,10 @@ function repos.deploy_local_files(name, version, wrap_bin_scripts, deps_mode)
          end
          local target = mode == "nv" and paths.nv or paths.v
          local backup = name ~= cur_name or version ~= cur_version
-         table.insert(installs, { fn = move_lua, src = source, dst = target, backup = backup })
+         table.insert(installs, { perms = "read", src = source, dst = target, backup = backup })
+         if file_path:match("%.lua$") then
+            lua_files[target] = file_path
+         end
          return true
       end)
    end
@@ -542,7 +679,7 @@ function repos.deploy_local_files(name, version, wrap_bin_scripts, deps_mode)
          end
          local target = mode == "nv" and paths.nv or paths.v
          local backup = name ~= cur_name or version ~= cur_version
-         table.insert(installs, { fn = move_lib, src = source, dst = target, backup = backup })
+         table.insert(installs, { perms = "exec", src = source, dst = target, backup = backup })
          return true
       end)
    end
@@ -554,22 +691,21 @@ function repos.deploy_local_files(name, version, wrap_bin_scripts, deps_mode)
          return nil, err
       end
    end
-   local op_install, done_op_install = prepare_op_install()
-   for i, op in ipairs(installs) do
-      local ok, err = op_install(op)
-      if not ok then
-         rollback_ops(installs, rollback_install, i - 1)
-         rollback_ops(renames, rollback_rename, #renames)
-         return nil, err
-      end
+   local ok, err = run_installs(installs)
+   if not ok then
+      rollback_ops(renames, rollback_rename, #renames)
+      return nil, err
    end
-   done_op_install()
 
-   local ok, err = repos.check_everything_is_installed(name, version, rock_manifest, repo, true)
+   ok, err = repos.check_everything_is_installed(name, version, rock_manifest, repo, true)
    if not ok then
       return nil, err
    end
 
+   if cfg.lua_bytecode_cache and next(lua_files) then
+      precompile_lua_files(name, version, lua_files)
+   end
+
    return true
 end
 
@@ -711,6 +847,11 @@ function repos.delete_local_version(name, version, _deps_mode, quick)
    if not get_installed_versions(name) then
       fs.delete(dir.path(cfg.rocks_dir, name))
    end
+   local bytecode_dir = path.bytecode_dir(name, version)
+   if fs.exists(bytecode_dir) then
+      fs.delete(bytecode_dir)
+      fs.remove_dir_if_empty(dir.dir_name(bytecode_dir))
+   end
 
    if quick then
       return true, nil, "ok"
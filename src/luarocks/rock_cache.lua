@@ -0,0 +1,127 @@
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local table = _tl_compat and _tl_compat.table or table
+
+
+
+
+
+
+
+local rock_cache = {}
+
+
+local fs = require("luarocks.fs")
+local dir = require("luarocks.dir")
+local cfg = require("luarocks.core.cfg")
+local util = require("luarocks.util")
+local deps = require("luarocks.deps")
+local pack = require("luarocks.pack")
+local queries = require("luarocks.queries")
+
+
+
+local key_variables = { "CC", "CFLAGS", "LD", "LDFLAGS", "LIBFLAG", "LUA_INCDIR", "LUA_LIBDIR", "LUALIB", "CMAKE", "MAKE" }
+
+
+
+
+
+
+
+
+function rock_cache.entry_dir(rockspec)
+   local cache_dir = cfg.binary_rock_cache_dir
+   if not cache_dir or not rockspec.local_abs_filename then
+      return nil
+   end
+
+   if rockspec.version:match("^scm%-") or rockspec.version:match("^dev%-") then
+      return nil
+   end
+   local checksum = fs.get_md5(rockspec.local_abs_filename)
+   if not checksum or not deps.check_external_deps(rockspec, "build") then
+      return nil
+   end
+
+   local key = { checksum, cfg.arch, cfg.lua_version }
+   for _, var in ipairs(key_variables) do
+      table.insert(key, var .. "=" .. tostring(rockspec.variables[var]))
+   end
+   for name in util.sortedpairs(rockspec.external_dependencies or {}) do
+      for _, suffix in ipairs({ "_DIR", "_INCDIR", "_LIBDIR", "_BINDIR" }) do
+         table.insert(key, name .. suffix .. "=" .. tostring(rockspec.variables[name .. suffix]))
+      end
+   end
+
+
+
+   local temp_dir = fs.make_temp_dir("rock-cache-key")
+   if not temp_dir then
+      return nil
+   end
+   local keyfile = dir.path(temp_dir, "key")
+   local fd = io.open(keyfile, "wb")
+   local hash
+   if fd then
+      fd:write(table.concat(key, "\n"), "\n")
+      fd:close()
+      hash = fs.get_md5(keyfile)
+   end
+   fs.delete(temp_dir)
+   if not hash then
+      return nil
+   end
+   return dir.path(cache_dir, rockspec.name, rockspec.version, hash)
+end
+
+
+
+
+function rock_cache.find(entry)
+   if not fs.is_dir(entry) then
+      return nil
+   end
+   for _, file in ipairs(fs.list_dir(entry)) do
+      if file:match("%.rock$") then
+         return dir.path(entry, file)
+      end
+   end
+end
+
+
+
+
+
+
+
+
+
+
+function rock_cache.store(entry, name, version, namespace)
+   local ok, err = fs.make_dir(entry)
+   local temp_dir
+   if ok then
+      temp_dir, err = fs.make_temp_dir("rock-cache", entry)
+      ok = temp_dir ~= nil
+   end
+   if ok then
+      ok, err = fs.change_dir(temp_dir)
+   end
+   if not ok then
+      util.warning("Failed storing binary rock in cache: " .. err)
+      return
+   end
+   local file
+   file, err = pack.pack_installed_rock(queries.new(name, namespace, version), cfg.root_dir)
+   fs.pop_dir()
+   if file then
+      if not os.rename(file, dir.path(entry, dir.base_name(file))) then
+         err = "could not move " .. file .. " into " .. entry
+      end
+   end
+   fs.delete(temp_dir)
+   if err then
+      util.warning("Failed storing binary rock in cache: " .. err)
+   end
+end
+
+return rock_cache
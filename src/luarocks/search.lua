@@ -20,6 +20,8 @@ local results = require("luarocks.results")
 
 
 
+
+
 function search.store_result(result_tree, result)
 
    local name = result.name
@@ -104,9 +106,19 @@ local function manifest_search(result_tree, repo, query, lua_version, is_local)
       repo = repo .. "/manifests/" .. query.namespace
    end
 
-   local manifest, err, errcode = manif.load_manifest(repo, lua_version, not is_local)
+   local manifest
+   if (not is_local) and query.name ~= "" and not query.substring then
+
+
+
+      manifest = manif.load_manifest_shard(repo, query.name, lua_version)
+   end
    if not manifest then
-      return nil, err, errcode
+      local err, errcode
+      manifest, err, errcode = manif.load_manifest(repo, lua_version, not is_local)
+      if not manifest then
+         return nil, err, errcode
+      end
    end
    for name, versions in pairs(manifest.repository) do
       for version, items in pairs(versions) do
@@ -180,6 +192,24 @@ end
 
 
 
+
+function search.pick_rock_url(name, version, items)
+   local pick = 1
+   for i, item in ipairs(items) do
+      if (item.arch == 'src' and items[pick].arch == 'rockspec') or
+      (item.arch ~= 'src' and item.arch ~= 'rockspec') then
+         pick = i
+      end
+   end
+   return path.make_url(items[pick].repo, name, version, items[pick].arch)
+end
+
+
+
+
+
+
+
 local function pick_latest_version(name, versions)
    assert(not name:match("/"))
 
@@ -191,14 +221,7 @@ local function pick_latest_version(name, versions)
    local version = vtables[#vtables].string
    local items = versions[version]
    if items then
-      local pick = 1
-      for i, item in ipairs(items) do
-         if (item.arch == 'src' and items[pick].arch == 'rockspec') or
-            (item.arch ~= 'src' and item.arch ~= 'rockspec') then
-            pick = i
-         end
-      end
-      return path.make_url(items[pick].repo, name, version, items[pick].arch)
+      return search.pick_rock_url(name, version, items)
    end
    return nil
 end
@@ -0,0 +1,203 @@
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local table = _tl_compat and _tl_compat.table or table
+
+
+
+
+
+
+
+
+
+local shared_store = { Stats = {} }
+
+
+
+
+
+
+local fs = require("luarocks.fs")
+local dir = require("luarocks.dir")
+local cfg = require("luarocks.core.cfg")
+
+
+
+
+local reflinks_work
+
+local function store_dir()
+   return cfg.shared_store_dir
+end
+
+local function object_path(store, digest, perms)
+   local name = perms == "exec" and digest .. ".x" or digest
+   return dir.path(store, "objects", digest:sub(1, 2), name)
+end
+
+
+
+
+local function link(src, dest)
+   local how = cfg.shared_store_link or "auto"
+   if how ~= "hardlink" and reflinks_work ~= false then
+      if fs.reflink(src, dest) then
+         reflinks_work = true
+         return true
+      end
+
+      os.remove(dest)
+      if how == "reflink" then
+         return false
+      end
+      reflinks_work = false
+   end
+   return (fs.link(src, dest))
+end
+
+local function replace_with_link(object, file)
+   local temp = file .. ".shared"
+   os.remove(temp)
+   if link(object, temp) and os.rename(temp, file) then
+      return true
+   end
+   os.remove(temp)
+   return false
+end
+
+
+
+function shared_store.enabled()
+   return store_dir() ~= nil
+end
+
+
+
+
+
+
+
+
+function shared_store.share(files, perms)
+   local store = store_dir()
+   if not store or #files == 0 then
+      return 0
+   end
+   local sums = fs.get_checksums(files, "sha256")
+   if not sums then
+      return 0
+   end
+
+
+
+   local staging_dir = dir.path(store, "tmp")
+   fs.make_dir(staging_dir)
+   local staging = fs.make_temp_dir("shared", staging_dir)
+   local made = {}
+   local shared = 0
+   local adding = {}
+   local sources = {}
+   local new_objects = {}
+   local duplicates = {}
+   for _, file in ipairs(files) do
+      local object = object_path(store, sums[file], perms)
+      if adding[object] then
+         table.insert(duplicates, file)
+      elseif fs.exists(object) then
+         if replace_with_link(object, file) then
+            shared = shared + 1
+         end
+      elseif staging then
+         local subdir = dir.dir_name(object)
+         if not made[subdir] then
+            made[subdir] = fs.make_dir(subdir) or false
+         end
+         local partial = dir.path(staging, dir.base_name(object))
+         if made[subdir] and link(file, partial) then
+            adding[object] = partial
+            sources[object] = file
+            table.insert(new_objects, object)
+         end
+      end
+   end
+
+   local partials = {}
+   for i, object in ipairs(new_objects) do
+      partials[i] = adding[object]
+   end
+   local ok = #partials == 0 or fs.set_permissions_many(partials, perms, "shared")
+   for i, object in ipairs(new_objects) do
+
+
+      if ok and fs.link(partials[i], object) then
+         shared = shared + 1
+      elseif fs.exists(object) then
+         table.insert(duplicates, sources[object])
+      end
+   end
+   if staging then
+      fs.delete(staging)
+   end
+
+
+   for _, file in ipairs(duplicates) do
+      local object = object_path(store, sums[file], perms)
+      if fs.exists(object) and replace_with_link(object, file) then
+         shared = shared + 1
+      end
+   end
+   return shared
+end
+
+local function each_object(store, fn)
+   local objects_dir = dir.path(store, "objects")
+   for _, subdir in ipairs(fs.list_dir(objects_dir)) do
+      for _, file in ipairs(fs.list_dir(dir.path(objects_dir, subdir))) do
+         fn(dir.path(objects_dir, subdir, file))
+      end
+   end
+end
+
+
+
+function shared_store.stats()
+   local stats = { files = 0, size = 0 }
+   local store = store_dir()
+   if not store or not fs.exists(store) then
+      return stats
+   end
+   each_object(store, function(pathname)
+      local fd = io.open(pathname, "rb")
+      if fd then
+         stats.files = stats.files + 1
+         stats.size = stats.size + fd:seek("end")
+         fd:close()
+      end
+   end)
+   return stats
+end
+
+
+
+
+
+
+
+function shared_store.prune()
+   local store = store_dir()
+   if not store or not fs.exists(store) then
+      return 0
+   end
+   local removed = 0
+   each_object(store, function(pathname)
+      if fs.link_count(pathname) == 1 then
+         os.remove(pathname)
+         removed = removed + 1
+      end
+   end)
+   local objects_dir = dir.path(store, "objects")
+   for _, subdir in ipairs(fs.list_dir(objects_dir)) do
+      fs.remove_dir_if_empty(dir.path(objects_dir, subdir))
+   end
+   return removed
+end
+
+return shared_store
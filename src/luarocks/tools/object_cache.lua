@@ -0,0 +1,175 @@
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local pairs = _tl_compat and _tl_compat.pairs or pairs; local table = _tl_compat and _tl_compat.table or table
+
+
+
+
+
+
+local object_cache = { Cache = {} }
+
+
+
+
+
+
+
+
+
+local fs = require("luarocks.fs")
+local dir = require("luarocks.dir")
+local persist = require("luarocks.persist")
+local util = require("luarocks.util")
+
+
+
+
+
+
+
+
+
+
+local function file_size(filename)
+   local fd = io.open(filename, "rb")
+   if not fd then
+      return nil
+   end
+   local size = fd:seek("end")
+   fd:close()
+   return size
+end
+
+local function object_path(cache, key)
+   return dir.path(cache.dir, key:sub(1, 2), key)
+end
+
+
+
+
+function object_cache.open(cache_dir)
+   local ok, err = fs.make_dir(cache_dir)
+   if not ok then
+      return nil, "Failed creating object cache directory " .. cache_dir .. ": " .. err
+   end
+   return { dir = cache_dir, hits = 0, misses = 0, used = {}, added = {} }
+end
+
+
+
+
+
+
+
+function object_cache.key(preprocessed, command)
+   local fd, err = io.open(preprocessed, "ab")
+   if not fd then
+      return nil, err
+   end
+   fd:write("\n", command, "\n")
+   fd:close()
+   return fs.get_md5(preprocessed)
+end
+
+
+
+
+
+
+function object_cache.fetch(cache, key, object)
+   local cached = object_path(cache, key)
+   if fs.exists(cached) and fs.copy(cached, object) then
+      cache.hits = cache.hits + 1
+      cache.used[key] = os.time()
+      return true
+   end
+   cache.misses = cache.misses + 1
+   return false
+end
+
+
+
+
+
+
+
+function object_cache.store(cache, key, object)
+   local cached = object_path(cache, key)
+   local partial = cached .. ".part" .. tostring(math.random(100000000))
+   if fs.make_dir(dir.dir_name(cached)) and fs.copy(object, partial) then
+      if os.rename(partial, cached) then
+         cache.added[key] = file_size(cached)
+         cache.used[key] = os.time()
+      else
+         os.remove(partial)
+      end
+   end
+end
+
+
+
+
+local function evict(cache, objects, total, max_size)
+   for _, subdir in ipairs(fs.list_dir(cache.dir)) do
+      if #subdir == 2 and fs.is_dir(dir.path(cache.dir, subdir)) then
+         for _, key in ipairs(fs.list_dir(dir.path(cache.dir, subdir))) do
+            if not objects[key] and not key:match("%.part") then
+               local size = file_size(object_path(cache, key)) or 0
+               objects[key] = { size = size, used = 0 }
+               total = total + size
+            end
+         end
+      end
+   end
+   local keys = util.keys(objects)
+   table.sort(keys, function(a, b)
+      return objects[a].used < objects[b].used
+   end)
+   for _, key in ipairs(keys) do
+      if total <= max_size then
+         break
+      end
+      os.remove(object_path(cache, key))
+      total = total - objects[key].size
+      objects[key] = nil
+   end
+   return total
+end
+
+
+
+
+
+function object_cache.close(cache, max_size)
+   if cache.hits + cache.misses == 0 then
+      return
+   end
+   util.printout("Object cache: " .. cache.hits .. " hits, " .. cache.misses .. " misses")
+
+   local lock = fs.lock_access(cache.dir)
+   if not lock then
+      return
+   end
+   local index_file = dir.path(cache.dir, "index")
+   local objects = {}
+   if fs.exists(index_file) then
+      local index = persist.load_into_table(index_file)
+      objects = index and index.objects or {}
+   end
+   for key, used in pairs(cache.used) do
+      local entry = objects[key] or { size = cache.added[key] or file_size(object_path(cache, key)) or 0 }
+      entry.used = used
+      objects[key] = entry
+   end
+   local total = 0
+   for _, entry in pairs(objects) do
+      total = total + entry.size
+   end
+   local max_bytes = math.floor(max_size * 1024 * 1024)
+   if total > max_bytes then
+      evict(cache, objects, total, math.floor(max_bytes * 0.9))
+   end
+   persist.save_from_table(index_file, { objects = objects })
+   fs.unlock_access(lock)
+end
+
+return object_cache
@@ -1,4 +1,4 @@
-local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local math = _tl_compat and _tl_compat.math or math; local string = _tl_compat and _tl_compat.string or string
+local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table
 
 local tar = { Header = {} }
 
@@ -29,6 +29,16 @@ local fun = require("luarocks.fun")
 
 local blocksize = 512
 
+
+local bufsize = 65536
+
+
+
+
+
+
+
+
 local function get_typeflag(flag)
    if flag == "0" or flag == "\0" then return "file"
    elseif flag == "1" then return "link"
@@ -47,18 +57,8 @@ local function get_typeflag(flag)
 end
 
 local function octal_to_number(octal)
-   local exp = 0
-   local number = 0
-   octal = octal:gsub("%s", "")
-   for i = #octal, 1, -1 do
-      local digit = math.tointeger(octal:sub(i, i))
-      if not digit then
-         break
-      end
-      number = number + (digit * math.tointeger(8 ^ exp))
-      exp = exp + 1
-   end
-   return number
+   local digits = (octal:gsub("%s", "")):match("[0-7]*$")
+   return math.tointeger(tonumber(digits, 8) or 0)
 end
 
 local function checksum_header(block)
@@ -68,12 +68,10 @@ local function checksum_header(block)
       return 0
    end
 
-   for i = 1, 148 do
-      local b = block:byte(i) or 0
+   for _, b in ipairs({ block:byte(1, 148) }) do
       sum = sum + b
    end
-   for i = 157, 500 do
-      local b = block:byte(i) or 0
+   for _, b in ipairs({ block:byte(157, 500) }) do
       sum = sum + b
    end
 
@@ -117,20 +115,71 @@ local function read_header_block(block)
    return header
 end
 
-function tar.untar(filename, destdir)
 
-   local tar_handle = io.open(filename, "rb")
-   if not tar_handle then return nil, "Error opening file " .. filename end
 
+local function read(r, n)
+   local avail = #r.buffer - r.pos + 1
+   if avail >= n then
+      local data = r.buffer:sub(r.pos, r.pos + n - 1)
+      r.pos = r.pos + n
+      return data
+   end
+   local parts = { r.buffer:sub(r.pos) }
+   local got = avail
+   r.buffer, r.pos = "", 1
+   while got < n do
+      local chunk = r.next_chunk()
+      if not chunk then
+         break
+      end
+      if got + #chunk > n then
+         table.insert(parts, chunk:sub(1, n - got))
+         r.buffer, r.pos = chunk, n - got + 1
+         got = n
+      else
+         table.insert(parts, chunk)
+         got = got + #chunk
+      end
+   end
+   return table.concat(parts)
+end
+
+
+
+
+local function read_data(r, size, fn)
+   local padding = math.ceil(size / blocksize) * blocksize - size
+   while size > 0 do
+      local data = read(r, math.min(size, bufsize))
+      if #data == 0 then
+         return false
+      end
+      if fn then
+         fn(data)
+      end
+      size = size - #data
+   end
+   return #read(r, padding) == padding
+end
+
+
+
+
+
+
+
+function tar.untar_stream(next_chunk, destdir)
+
+   local r = { next_chunk = next_chunk, buffer = "", pos = 1 }
    local long_name, long_link_name
    local ok, err
    local make_dir = fun.memoize(fs.make_dir)
    while true do
       local block
       repeat
-         block = tar_handle:read(blocksize)
-      until (not block) or block:byte(1) > 0
-      if not block then break end
+         block = read(r, blocksize)
+      until #block == 0 or block:byte(1) > 0
+      if #block == 0 then break end
       if #block < blocksize then
          ok, err = nil, "Invalid block size -- corrupted file?"
          break
@@ -142,19 +191,18 @@ function tar.untar(filename, destdir)
          ok = false
          break
       end
-      local file_data = ""
-      if header.size > 0 then
-         local nread = math.ceil(header.size / blocksize) * blocksize
-         file_data = tar_handle:read(header.size)
-         if nread > header.size then
-            tar_handle:seek("cur", nread - header.size)
-         end
-      end
 
-      if header.typeflag == "long name" then
-         long_name = nullterm(file_data)
-      elseif header.typeflag == "long link name" then
-         long_link_name = nullterm(file_data)
+      if header.typeflag == "long name" or header.typeflag == "long link name" then
+         local parts = {}
+         if not read_data(r, header.size, function(data) table.insert(parts, data) end) then
+            ok, err = nil, "Invalid block size -- corrupted file?"
+            break
+         end
+         if header.typeflag == "long name" then
+            long_name = nullterm(table.concat(parts))
+         else
+            long_link_name = nullterm(table.concat(parts))
+         end
       else
          if long_name then
             header.name = long_name
@@ -186,14 +234,23 @@ function tar.untar(filename, destdir)
             ok = nil
             break
          end
-         file_handle:write(file_data)
+         local complete = read_data(r, header.size, function(data) file_handle:write(data) end)
          file_handle:close()
+         if not complete then
+            ok, err = nil, "Invalid block size -- corrupted file?"
+            break
+         end
          fs.set_time(pathname, header.mtime)
          if header.mode:match("[75]") then
             fs.set_permissions(pathname, "exec", "all")
          else
             fs.set_permissions(pathname, "read", "all")
          end
+      elseif header.typeflag ~= "long name" and header.typeflag ~= "long link name" then
+         if not read_data(r, header.size) then
+            ok, err = nil, "Invalid block size -- corrupted file?"
+            break
+         end
       end
 
 
@@ -202,6 +259,17 @@ function tar.untar(filename, destdir)
 
 
    end
+   return ok, err
+end
+
+function tar.untar(filename, destdir)
+
+   local tar_handle = io.open(filename, "rb")
+   if not tar_handle then return nil, "Error opening file " .. filename end
+
+   local ok, err = tar.untar_stream(function()
+      return tar_handle:read(bufsize)
+   end, destdir)
    tar_handle:close()
    return ok, err
 end
@@ -1,7 +1,16 @@
 local _tl_compat; if (tonumber((_VERSION or ''):match('[%d.]*$')) or 0) < 5.3 then local p, m = pcall(require, 'compat53.module'); if p then _tl_compat = m end end; local io = _tl_compat and _tl_compat.io or io; local ipairs = _tl_compat and _tl_compat.ipairs or ipairs; local math = _tl_compat and _tl_compat.math or math; local os = _tl_compat and _tl_compat.os or os; local string = _tl_compat and _tl_compat.string or string; local table = _tl_compat and _tl_compat.table or table; local _tl_table_pack = table.pack or function(...) return { n = select("#", ...), ... } end; local type = type
 
 
-local zip = { ZipHandle = {}, LocalFileHeader = {}, Zip = {} }
+local zip = { ZipHandle = {}, LocalFileHeader = {}, Zip = {}, ZipReader = {} }
+
+
+
+
+
+
+
+
+
 
 
 
@@ -55,6 +64,10 @@ local dir = require("luarocks.dir")
 
 
 
+
+
+local CHUNK_SIZE = 65536
+
 local function shr(n, m)
    return math.floor(n / 2 ^ m)
 end
@@ -82,6 +95,8 @@ end
 local zlib_compress
 local zlib_uncompress
 local zlib_crc32
+local zlib_inflate_chunks
+local zlib_crc32_stream
 if zlib._VERSION:match("^lua%-zlib") then
    function zlib_compress(data, mode)
       return (zlib.deflate(6, mode_to_windowbits(mode))(data, "finish"))
@@ -94,6 +109,20 @@ if zlib._VERSION:match("^lua%-zlib") then
    function zlib_crc32(data)
       return zlib.crc32()(data)
    end
+
+   function zlib_inflate_chunks(read, mode)
+      local stream = zlib.inflate(mode_to_windowbits(mode))
+      return function()
+         local chunk = read()
+         if chunk then
+            return (stream(chunk))
+         end
+      end
+   end
+
+   function zlib_crc32_stream()
+      return zlib.crc32()
+   end
 elseif zlib._VERSION:match("^lzlib") then
    function zlib_compress(data, mode)
       return zlib.compress(data, -1, nil, mode_to_windowbits(mode))
@@ -106,6 +135,21 @@ elseif zlib._VERSION:match("^lzlib") then
    function zlib_crc32(data)
       return zlib.crc32(zlib.crc32(), data)
    end
+
+   function zlib_inflate_chunks(read, mode)
+      local stream = zlib.inflate({ read = function() return read() end }, mode_to_windowbits(mode))
+      return function()
+         return stream:read(CHUNK_SIZE)
+      end
+   end
+
+   function zlib_crc32_stream()
+      local crc = zlib.crc32()
+      return function(data)
+         crc = zlib.crc32(crc, data)
+         return crc
+      end
+   end
 else
    error("unknown zlib library", 0)
 end
@@ -371,7 +415,15 @@ local function ziptime_to_luatime(ztime, zdate)
    return date
 end
 
-local function read_file_in_zip(zh, cdr)
+
+
+
+
+
+
+
+
+local function extract_file_in_zip(zh, cdr, pathname)
    local sig = zh:read(4)
    if sig ~= LOCAL_FILE_HEADER_SIGNATURE then
       return nil, "failed reading Local File Header signature"
@@ -385,25 +437,52 @@ local function read_file_in_zip(zh, cdr)
    zh:read(file_name_length)
    zh:read(extra_field_length)
 
-   local data = zh:read(cdr.compressed_size)
+   local remaining = cdr.compressed_size
+   local function read_compressed()
+      if remaining <= 0 then
+         return nil
+      end
+      local data = zh:read(math.min(CHUNK_SIZE, remaining))
+      remaining = remaining - #(data or "")
+      return data
+   end
 
-   local uncompressed
+   local next_chunk
    if cdr.compression_method == 8 then
-      uncompressed = zlib_uncompress(data, "raw")
+      next_chunk = zlib_inflate_chunks(read_compressed, "raw")
    elseif cdr.compression_method == 0 then
-      uncompressed = data
+      next_chunk = read_compressed
    else
       return nil, "unknown compression method " .. cdr.compression_method
    end
 
-   if #uncompressed ~= cdr.uncompressed_size then
-      return nil, "uncompressed size doesn't match"
+   local wf, erropen = io.open(pathname, "wb")
+   if not wf then
+      return nil, erropen
    end
-   if cdr.crc32 ~= zlib_crc32(uncompressed) then
-      return nil, "crc32 failed (expected " .. cdr.crc32 .. ") - data: " .. uncompressed
+   local crc32 = zlib_crc32_stream()
+   local crc = 0
+   local size = 0
+   local chunk = next_chunk()
+   while chunk do
+      size = size + #chunk
+      crc = crc32(chunk)
+      wf:write(chunk)
+      chunk = next_chunk()
    end
+   wf:close()
 
-   return uncompressed
+   local err
+   if size ~= cdr.uncompressed_size then
+      err = "uncompressed size doesn't match"
+   elseif cdr.crc32 ~= crc then
+      err = "crc32 failed (expected " .. cdr.crc32 .. ")"
+   end
+   if err then
+      os.remove(pathname)
+      return nil, err
+   end
+   return true
 end
 
 local function process_end_of_central_dir(zh)
@@ -481,75 +560,134 @@ end
 
 
 
-function zip.unzip(zipfile)
-   zipfile = fs.absolute_name(zipfile)
-   local zh, erropen = io.open(zipfile, "rb")
+
+
+local function extract_entry(zh, cdr, pathname)
+   local file = cdr.file_name
+   if file:sub(#file) == "/" then
+      return fs.make_dir(pathname)
+   end
+
+   local base = dir.dir_name(pathname)
+   if base ~= "" and not fs.is_dir(base) then
+      local okmake, errmake = fs.make_dir(base)
+      if not okmake then
+         return nil, errmake
+      end
+   end
+
+   local okseek, errseek = zh:seek("set", cdr.offset)
+   if not okseek then
+      return nil, errseek
+   end
+
+   local ok, err = extract_file_in_zip(zh, cdr, pathname)
+   if not ok then
+      return nil, err
+   end
+
+   if cdr.external_attr > 0 then
+      fs.set_permissions(pathname, "exec", "all")
+   else
+      fs.set_permissions(pathname, "read", "all")
+   end
+   fs.set_time(pathname, cdr.last_mod_luatime)
+   return true
+end
+
+local function zipreader_list(zr)
+   local names = {}
+   for i, cdr in ipairs(zr.files) do
+      names[i] = cdr.file_name
+   end
+   return names
+end
+
+local function zipreader_extract(zr, name, pathname)
+   local cdr = zr.by_name[name]
+   if not cdr then
+      return nil, name .. " not found in archive"
+   end
+   return extract_entry(zr.handle, cdr, pathname or dir.path(fs.current_dir(), name))
+end
+
+local function zipreader_close(zr)
+   zr.handle:close()
+end
+
+
+
+
+
+
+
+function zip.new_zipreader(zipfile)
+   local zh, erropen = io.open(fs.absolute_name(zipfile), "rb")
    if not zh then
       return nil, erropen
    end
 
    local cd_entries, cd_offset = process_end_of_central_dir(zh)
    if type(cd_offset) == "string" then
+      zh:close()
       return nil, cd_offset
    end
 
    local okseek, errseek = zh:seek("set", cd_offset)
    if not okseek then
+      zh:close()
       return nil, errseek
    end
 
    local files, errproc = process_central_dir(zh, cd_entries)
    if not files then
+      zh:close()
       return nil, errproc
    end
 
+   local zr = {}
+   zr.handle = zh
+   zr.files = files
+   zr.by_name = {}
    for _, cdr in ipairs(files) do
-      local file = cdr.file_name
-      if file:sub(#file) == "/" then
-         local okmake, errmake = fs.make_dir(dir.path(fs.current_dir(), file))
-         if not okmake then
-            return nil, errmake
-         end
-      else
-         local base = dir.dir_name(file)
-         if base ~= "" then
-            base = dir.path(fs.current_dir(), base)
-            if not fs.is_dir(base) then
-               local okmake, errmake = fs.make_dir(base)
-               if not okmake then
-                  return nil, errmake
-               end
-            end
-         end
+      zr.by_name[cdr.file_name] = cdr
+   end
 
-         local okseek2, errseek2 = zh:seek("set", cdr.offset)
-         if not okseek2 then
-            return nil, errseek2
-         end
+   zr.list = zipreader_list
+   zr.extract = zipreader_extract
+   zr.close = zipreader_close
 
-         local contents, err = read_file_in_zip(zh, cdr)
-         if not contents then
-            return nil, err
-         end
-         local pathname = dir.path(fs.current_dir(), file)
-         local wf, erropen2 = io.open(pathname, "wb")
-         if not wf then
-            zh:close()
-            return nil, erropen2
-         end
-         wf:write(contents)
-         wf:close()
+   return zr
+end
 
-         if cdr.external_attr > 0 then
-            fs.set_permissions(pathname, "exec", "all")
-         else
-            fs.set_permissions(pathname, "read", "all")
-         end
-         fs.set_time(pathname, cdr.last_mod_luatime)
+
+
+
+
+
+
+function zip.unzip(zipfile, ...)
+   local zr, err = zip.new_zipreader(zipfile)
+   if not zr then
+      return nil, err
+   end
+
+   local names = { ... }
+   if #names == 0 then
+      names = zr:list()
+   end
+
+
+
+   local ok = true
+   for _, name in ipairs(names) do
+      local eok, eerr = zr:extract(name)
+      if not eok and ok then
+         ok, err = eok, eerr
       end
    end
-   zh:close()
-   return true
+   zr:close()
+   return ok, err
 end
 
 function zip.gzip(input_filename, output_filename)
@@ -572,4 +710,24 @@ function zip.gunzip(input_filename, output_filename)
    return fs.filter_file(fn, input_filename, output_filename)
 end
 
+
+
+
+
+
+function zip.gunzip_chunks(input_filename)
+   local fd, err = io.open(input_filename, "rb")
+   if not fd then
+      return nil, err
+   end
+   return zlib_inflate_chunks(function()
+      local data = fd and fd:read(CHUNK_SIZE)
+      if not data and fd then
+         fd:close()
+         fd = nil
+      end
+      return data
+   end, "gzip")
+end
+
 return zip
@@ -10,6 +10,7 @@ local cfg = require("luarocks.core.cfg")
 
 
 
+
 local util = { Fn = {} }
 
 
@@ -30,6 +31,7 @@ local util = { Fn = {} }
 
 
 
+
 
 util.cleanup_path = core.cleanup_path
 util.split_string = core.split_string
@@ -44,6 +46,7 @@ util.keys = core.keys
 util.matchquote = core.matchquote
 util.exists = core.exists
 util.starts_with = core.starts_with
+util.file_stamp = core.file_stamp
 
 
 
@@ -384,6 +387,16 @@ function util.namespaced_name_action(args, target, ns_name)
    end
 end
 
+--- Argparse converter for the number of jobs to run at the same time,
+-- which must be a positive integer.
+function util.jobs_count(s)
+   local n = tonumber(s)
+   if not n or n < 1 or n ~= math.floor(n) then
+      return nil, "invalid number of jobs '" .. s .. "': expected a positive integer"
+   end
+   return math.floor(n)
+end
+
 function util.deep_copy(tbl)
    local copy = {}
    for k, v in pairs(tbl) do